@@ -6,12 +6,16 @@
  *      Adapted from (and compatible with) Eric Middleton's timer utility
  */
 
-// TODO: Check value of MICROS_PER_TICK
-
 #include "Timer.h"
+#include "clock.h"
+#include "isrstat.h"
+#include "wheel.h"
+#include "driverlib/cpu.h" // for CPUwfi, CPUcpsid, CPUcpsie
+
+#define TICKS_PER_MICRO ((uint64_t)CLOCK_TICKS_PER_MICRO) // WTIMER0 counts system clock cycles
+#define TICKS_PER_MILLI ((uint64_t)CLOCK_TICKS_PER_MILLI)
 
-// 65000 gives a countdown time of exactly 65ms TODO: is it 65000 or 64999?
-#define MICROS_PER_TICK 64999UL // Number of microseconds in one timer cycle
+#define WHEEL_TICK_MICROS 1000UL // TIMER4 tick period, 1ms
 
 /**
  * @brief Tracks if the clock is currently running or stopped
@@ -20,46 +24,61 @@
 unsigned char _running = 0;
 
 /**
- * @brief Tracks the number of milliseconds passed since a call to startClock()
+ * @brief Total clock cycles the CPU spent asleep inside timer waits
+ *
+ */
+static uint64_t _sleep_ticks = 0;
+
+/**
+ * @brief Measured cost of a timer_waitMicros() call, in clock cycles
  *
  */
-volatile unsigned int _timeout_ticks;
+static uint32_t _wait_overhead_ticks = 0;
+
+static void timer_matchHandler(void);
+static void timer_calibrateWaitMicros(void);
 
 /**
  * @brief Initialize and start the clock at 0. If the clock is
- * already running on a call, reset the time count back to 0. Uses TIMER5.
+ * already running on a call, reset the time count back to 0. Uses WTIMER0 as
+ * a free-running 64-bit counter, so no interrupt is needed to track time.
  *
  */
 void timer_init(void) {
     if (!_running) {
-        SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R5; // Turn on clock to TIMER5
-        TIMER5_CTL_R &= ~TIMER_CTL_TAEN;           // Disable TIMER5 for setup
-        TIMER5_CFG_R = TIMER_CFG_16_BIT;           // Set as 16-bit timer
-        TIMER5_TAMR_R = TIMER_TAMR_TAMR_PERIOD;    // Periodic, countdown mode
-        TIMER5_TAILR_R = MICROS_PER_TICK - 1;      // Countdown time of 65ms
-        TIMER5_ICR_R |= TIMER_ICR_TATOCINT; // Clear timeout interrupt status
-        TIMER5_TAPR_R = 0x0F;               // 15 gives a period of 1us
-        TIMER5_IMR_R |= TIMER_IMR_TATOIM;   // Allow TIMER5 timeout interrupts
-        NVIC_PRI23_R |= NVIC_PRI23_INTA_M;  // Priority 7 (lowest)
-        NVIC_EN2_R |= (1 << 28);             // Enable TIMER5 interrupts
-
-        IntRegister(INT_TIMER5A, timer_clockTickHandler); // Bind the ISR
-        TIMER5_CTL_R |= TIMER_CTL_TAEN; // Start TIMER5 counting
+        SYSCTL_RCGCWTIMER_R |= SYSCTL_RCGCWTIMER_R0; // Turn on clock to WTIMER0
+        while ((SYSCTL_PRWTIMER_R & SYSCTL_PRWTIMER_R0) == 0) {};
+        WTIMER0_CTL_R &= ~TIMER_CTL_TAEN;            // Disable WTIMER0 for setup
+        WTIMER0_CFG_R = TIMER_CFG_32_BIT_TIMER;      // Concatenate A and B, 64-bit
+        WTIMER0_TAMR_R = TIMER_TAMR_TAMR_PERIOD | TIMER_TAMR_TACDIR
+                       | TIMER_TAMR_TAMIE;           // Periodic, count up, match
+        WTIMER0_TAILR_R = 0xFFFFFFFF;                // Count up to 2^64 - 1
+        WTIMER0_TBILR_R = 0xFFFFFFFF;
+        WTIMER0_IMR_R = 0;                           // Match armed only while waiting
+        WTIMER0_ICR_R = TIMER_ICR_TAMCINT;           // Clear match interrupt status
+        NVIC_PRI23_R |= NVIC_PRI23_INTC_M;           // Priority 7 (lowest)
+        NVIC_EN2_R |= (1 << 30);                     // Enable WTIMER0A interrupts
+        IntRegister(INT_WTIMER0A, timer_matchHandler); // Bind the ISR
+        WTIMER0_TBV_R = 0;                           // Start the count at 0
+        WTIMER0_TAV_R = 0;
+        WTIMER0_CTL_R |= TIMER_CTL_TAEN; // Start WTIMER0 counting
 
         _running = 1;
+
+        timer_calibrateWaitMicros();
     }
 }
 
 /**
- * @brief Stop the clock and free up TIMER5. Resets the value returned by
+ * @brief Stop the clock and free up WTIMER0. Resets the value returned by
  * timer_getMillis() and timer_getMicros().
  *
  */
 void timer_stop(void) {
-    TIMER5_CTL_R &= ~TIMER_CTL_TAEN;            // Disable TIMER5
-    _timeout_ticks = 0;                         // Reset tick counter
-    TIMER5_TAV_R = MICROS_PER_TICK;             // Set TIMER5 back to the top
-    SYSCTL_RCGCTIMER_R &= ~SYSCTL_RCGCTIMER_R5; // Turn off clock to TIMER5
+    WTIMER0_CTL_R &= ~TIMER_CTL_TAEN;              // Disable WTIMER0
+    WTIMER0_TBV_R = 0;                             // Reset the count
+    WTIMER0_TAV_R = 0;
+    SYSCTL_RCGCWTIMER_R &= ~SYSCTL_RCGCWTIMER_R0;  // Turn off clock to WTIMER0
     _running = 0;
 }
 
@@ -68,7 +87,7 @@ void timer_stop(void) {
  *
  */
 void timer_pause(void) {
-    TIMER5_CTL_R &= ~TIMER_CTL_TAEN; // Disable TIMER5
+    WTIMER0_CTL_R &= ~TIMER_CTL_TAEN; // Disable WTIMER0
     _running = 0;
 }
 
@@ -77,10 +96,44 @@ void timer_pause(void) {
  *
  */
 void timer_resume(void) {
-    TIMER5_CTL_R |= TIMER_CTL_TAEN; // Enable TIMER5
+    WTIMER0_CTL_R |= TIMER_CTL_TAEN; // Enable WTIMER0
     _running = 1;
 }
 
+/**
+ * @brief Returns the number of system clock cycles counted since
+ * timer_init() was called. The high half is read twice so a carry out of the
+ * low half between the two reads is never missed, and interrupts are never
+ * disabled. Value does not roll over for thousands of years.
+ *
+ * @return uint64_t number of clock cycles since a call to timer_init()
+ */
+uint64_t timer_getTicks(void) {
+    uint32_t high;
+    uint32_t low;
+
+    if (!_running) {
+        timer_init();
+    }
+
+    do {
+        high = WTIMER0_TBR_R;
+        low = WTIMER0_TAR_R;
+    } while (high != WTIMER0_TBR_R); // Low half wrapped, read again
+
+    return ((uint64_t)high << 32) | low;
+}
+
+/**
+ * @brief Returns the number of microseconds passed since a call to
+ * timer_init(). Value does not roll over during a mission.
+ *
+ * @return uint64_t number of microseconds since a call to timer_init()
+ */
+uint64_t timer_getMicros64(void) {
+    return timer_getTicks() / TICKS_PER_MICRO;
+}
+
 /**
  * @brief Returns the number milliseconds that have passed since startClock()
  * was called. Value rolls over after about 49 days.
@@ -89,85 +142,75 @@ void timer_resume(void) {
  * timer_startClock()
  */
 unsigned int timer_getMillis(void) {
-    unsigned int ticks;
-    unsigned int millis;
-
-    TIMER5_IMR_R &= ~TIMER_IMR_TATOIM; // Disable timeout interrupts
-
-    millis = (MICROS_PER_TICK - TIMER5_TAR_R & 0xFFFF) / 1000;
-    if (TIMER5_RIS_R & TIMER_RIS_TATORIS) {
-        // If the timer overflows while we're getting the time
-        ticks = (_timeout_ticks + 1);
-        millis = 0;
-    } else {
-        ticks = _timeout_ticks;
-    }
-
-    TIMER5_IMR_R |= TIMER_IMR_TATOIM; // Reenable interrupts from TIMER timeout
-
-    return ticks * (MICROS_PER_TICK / 1000) + millis;
+    return (unsigned int)(timer_getTicks() / TICKS_PER_MILLI);
 }
 
 /**
  * @brief Returns the number of microseconds passed since a call to
- * startClock(). Value rolls over after about 71 minutes.
+ * startClock(). Value rolls over after about 71 minutes; use
+ * timer_getMicros64() for timestamps that must not wrap.
  *
  * @return unsigned int number of microseconds since a call to startClock()
  */
 unsigned int timer_getMicros(void) {
-    unsigned int ticks;
-    unsigned int micros;
-    if(!_running){
-           timer_init();
-    }
-    TIMER5_IMR_R &= ~TIMER_IMR_TATOIM; // Disable TIMER5 timeout interrupts
+    return (unsigned int)timer_getMicros64();
+}
 
-    micros = MICROS_PER_TICK - TIMER5_TAR_R & 0xFFFF;
+/**
+ * @brief Pauses execution for the specified number of microseconds. Spins on
+ * the WTIMER0 timebase against an absolute deadline, so the delay is exact at
+ * any system clock and interrupts during the wait do not make it drift.
+ * The measured cost of the call itself is taken off the deadline.
+ *
+ * @param delay_time number of microseconds to pause for
+ */
+void timer_waitMicros(uint32_t delay_time) {
+    uint64_t start = timer_getTicks();
+    uint64_t budget = delay_time * TICKS_PER_MICRO;
 
-    if (TIMER5_RIS_R & TIMER_RIS_TATORIS) {
-        // If the timer overflows while we're getting the time
-        ticks = (_timeout_ticks + 1);
-        micros = 0;
-    } else {
-        ticks = _timeout_ticks;
+    if (budget <= _wait_overhead_ticks) {
+        return; // The call itself already took this long
     }
 
-    TIMER5_IMR_R |= TIMER_IMR_TATOIM; // Reenable TIMER5 interrupts
+    uint64_t deadline = start + budget - _wait_overhead_ticks;
+    while (timer_getTicks() < deadline) {
+    }
+}
 
-    return ticks * MICROS_PER_TICK + micros;
+/**
+ * @brief Returns the measured cost of a call to timer_waitMicros(0), in clock
+ * cycles. Delays shorter than this return as soon as possible, and longer
+ * delays are accurate to within one timebase read.
+ *
+ * @return unsigned int clock cycles of timer_waitMicros() call overhead
+ */
+unsigned int timer_getWaitMicrosOverhead(void) {
+    return _wait_overhead_ticks;
 }
 
 /**
- * @brief Pauses execution for the specified number of microseconds.
+ * @brief Measures the cost of entering and leaving timer_waitMicros() so it
+ * can be taken off every deadline. The back to back timebase read is
+ * subtracted so only the extra cost of the call is kept.
  *
- * @param delay_time number of microseconds to pause for
  */
-//unsigned int
-void timer_waitMicros(uint32_t delay_time) {
+static void timer_calibrateWaitMicros(void) {
+    uint64_t t0, t1;
+    uint32_t read_cost;
+    uint32_t call_cost;
 
-    if (delay_time <= 2) {
-        // Overhead of the function call is around 1.5us
-        return;
-    } else {
-        delay_time -= 2;
-    }
+    _wait_overhead_ticks = 0;
 
-    while (delay_time > 0) { // ldr: 2, cmp: 1, bne: 1; 4 cycles
-        // 16 cycles = 1us: need 16 - 9 = 7 NOP cycles
-        // Experimentally, 6 is accurate. Missing a cycle?
-        asm(" NOP"
-            "\n"
-            " NOP"
-            "\n"
-            " NOP"
-            "\n"
-            " NOP"
-            "\n"
-            " NOP"
-            "\n"
-            " NOP");
-        delay_time--; // ldr: 2, subs: 1, str: 2; 5 cycles
-    }
+    t0 = timer_getTicks();
+    t1 = timer_getTicks();
+    read_cost = t1 - t0;
+
+    t0 = timer_getTicks();
+    timer_waitMicros(0);
+    t1 = timer_getTicks();
+    call_cost = t1 - t0;
+
+    _wait_overhead_ticks = (call_cost > read_cost) ? call_cost - read_cost : 0;
 }
 
 /**
@@ -177,27 +220,196 @@ void timer_waitMicros(uint32_t delay_time) {
  */
 //unsigned int
 void timer_waitMillis(uint32_t delay_time) {
+    timer_sleepUntil(timer_getTicks() + delay_time * TICKS_PER_MILLI);
+}
+
+/**
+ * @brief Sleeps with WFI until timer_getTicks() reaches the given deadline.
+ * A WTIMER0 match interrupt wakes the CPU at the deadline, and any other
+ * interrupt is serviced as soon as it arrives. Interrupts are masked only
+ * between the deadline check and WFI so a wakeup can not be missed. When
+ * called from inside an ISR this falls back to polling.
+ *
+ * @param deadline value of timer_getTicks() to wait for
+ */
+void timer_sleepUntil(uint64_t deadline) {
+    uint64_t now;
+    uint32_t was_masked;
+
+    if (NVIC_INT_CTRL_R & NVIC_INT_CTRL_VEC_ACT_M) {
+        // Lower priority interrupts can not wake us from inside an ISR
+        while (timer_getTicks() < deadline) {
+        }
+        return;
+    }
+
+    WTIMER0_TBMATCHR_R = (uint32_t)(deadline >> 32); // Match at the deadline
+    WTIMER0_TAMATCHR_R = (uint32_t)deadline;
+    WTIMER0_ICR_R = TIMER_ICR_TAMCINT;   // Clear stale match interrupt status
+    WTIMER0_IMR_R |= TIMER_IMR_TAMIM;    // Allow WTIMER0 match interrupts
+
+    while (1) {
+        was_masked = CPUcpsid();
+        now = timer_getTicks();
+        if (now >= deadline) {
+            if (!was_masked) {
+                CPUcpsie();
+            }
+            break;
+        }
 
-    unsigned int start = timer_getMicros();
-    unsigned int current_micros = timer_getMicros();
+        CPUwfi(); // Wakes on any pending interrupt, even while masked
+        _sleep_ticks += timer_getTicks() - now;
 
-    while (delay_time > 0) {
-        current_micros = timer_getMicros();
-        // Uses a while loop (instead of if) in case a long ISR is called
-        while (delay_time > 0 && ((current_micros - start) >= 1000)) {
-            delay_time--;
-            start += 1000;
-            current_micros = timer_getMicros();
+        if (!was_masked) {
+            CPUcpsie(); // Let the interrupt that woke us run
         }
     }
+
+    WTIMER0_IMR_R &= ~TIMER_IMR_TAMIM; // Disarm the match interrupt
+}
+
+/**
+ * @brief Returns the total number of clock cycles the CPU spent asleep inside
+ * timer_waitMillis() and timer_sleepUntil(). CPU-busy time over an interval is
+ * the change in timer_getTicks() minus the change in this value.
+ *
+ * @return uint64_t clock cycles spent asleep since reset
+ */
+uint64_t timer_getSleepTicks(void) {
+    return _sleep_ticks;
+}
+
+/**
+ * @brief ISR handler for the WTIMER0 match interrupt. Only needs to clear the
+ * flag, since its job is to wake the CPU from WFI.
+ *
+ */
+static void timer_matchHandler(void) {
+    uint64_t match = ((uint64_t)WTIMER0_TBMATCHR_R << 32) | WTIMER0_TAMATCHR_R;
+    uint32_t entry = isrstat_enter(ISRSTAT_TIMER_MATCH, (uint32_t)(timer_getTicks() - match));
+
+    WTIMER0_ICR_R = TIMER_ICR_TAMCINT; // Clear interrupt flag
+
+    isrstat_exit(ISRSTAT_TIMER_MATCH, entry);
+}
+
+static unsigned char _wheel_running = 0;
+
+static void timer_wheelTickHandler(void);
+
+/**
+ * @brief Set up TIMER4 as a 1ms periodic tick for the timer wheel and empty
+ * the wheel. Called on the first timer_fire*() call.
+ *
+ */
+static void timer_wheelInit(void) {
+    wheel_init();
+
+    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R4; // Turn on clock to TIMER4
+    while ((SYSCTL_PRTIMER_R & SYSCTL_PRTIMER_R4) == 0) {};
+    TIMER4_CTL_R &= ~TIMER_CTL_TAEN;           // Disable TIMER4 for setup
+    TIMER4_CFG_R = TIMER_CFG_16_BIT;           // Set as 16-bit timer
+    TIMER4_TAMR_R = TIMER_TAMR_TAMR_PERIOD;    // Periodic, countdown mode
+    TIMER4_TAPR_R = CLOCK_TIMER_PRESCALE_1US;  // Count once per 1us
+    TIMER4_TAILR_R = WHEEL_TICK_MICROS - 1;    // Countdown time of 1ms
+    TIMER4_ICR_R = TIMER_ICR_TATOCINT;   // Clear timeout interrupt status
+    TIMER4_IMR_R |= TIMER_IMR_TATOIM;    // Allow TIMER4 timeout interrupts
+    NVIC_PRI17_R = (NVIC_PRI17_R & ~NVIC_PRI17_INTC_M) | (6 << NVIC_PRI17_INTC_S); // Priority 6
+    NVIC_EN2_R |= (1 << 6);              // Enable TIMER4A interrupts (IRQ 70)
+
+    IntRegister(INT_TIMER4A, timer_wheelTickHandler); // Bind the ISR
+
+    _wheel_running = 1; // TIMER4 starts when the first timer is armed
 }
 
 /**
- * @brief ISR handler to increment the timeout variable for tracking total
- * milliseconds
+ * @brief Start TIMER4 if a timer is armed, stop it if none are, so idle
+ * can sleep. Caller must have TIMER4 interrupts masked or be its ISR.
  *
  */
-static void timer_clockTickHandler() {
-    TIMER5_ICR_R |= TIMER_ICR_TATOCINT; // Clear interrupt flag
-    _timeout_ticks++;
+static void timer_wheelClock(void) {
+    if (wheel_armed() == 0) {
+        TIMER4_CTL_R &= ~TIMER_CTL_TAEN; // Nothing left to time, stop ticking
+    } else if (!(TIMER4_CTL_R & TIMER_CTL_TAEN)) {
+        TIMER4_TAV_R = TIMER4_TAILR_R;  // Restart a full tick from now
+        TIMER4_CTL_R |= TIMER_CTL_TAEN; // Start TIMER4 counting
+    }
+}
+
+/**
+ * @brief Arm a wheel timer with TIMER4 interrupts masked.
+ *
+ * @return handle for timer_cancel(), or -1 if no timer is free
+ */
+static int timer_wheelArm(void (*f)(void), int millis, int times) {
+    int handle;
+
+    if (!f || millis < 0 || times == 0) {
+        return -1;
+    }
+    if (!_wheel_running) {
+        timer_wheelInit();
+    }
+
+    TIMER4_IMR_R &= ~TIMER_IMR_TATOIM; // Disable TIMER4 timeout interrupts
+    handle = wheel_arm(f, millis, times);
+    timer_wheelClock();
+    TIMER4_IMR_R |= TIMER_IMR_TATOIM; // Reenable TIMER4 interrupts
+
+    return handle;
+}
+
+int timer_fireEvery(void (*f)(void), int millis) {
+    return timer_wheelArm(f, millis, -1);
+}
+
+int timer_fireOnce(void (*f)(void), int millis) {
+    return timer_wheelArm(f, millis, 1);
+}
+
+int timer_fireFor(void (*f)(void), int millis, int times) {
+    if (times <= 0) {
+        return -1;
+    }
+    return timer_wheelArm(f, millis, times);
+}
+
+void timer_cancel(int handle) {
+    if (!_wheel_running) {
+        return;
+    }
+
+    TIMER4_IMR_R &= ~TIMER_IMR_TATOIM; // Disable TIMER4 timeout interrupts
+    wheel_cancel(handle);
+    timer_wheelClock();
+    TIMER4_IMR_R |= TIMER_IMR_TATOIM; // Reenable TIMER4 interrupts
+}
+
+/**
+ * @brief Clock cycles since TIMER4 last timed out, from its counter and the
+ * prescaler value held in bits 23:16 of TAV.
+ *
+ */
+static uint32_t timer_wheelLatency(void) {
+    uint32_t value = TIMER4_TAV_R;
+    uint32_t prescale = TIMER4_TAPR_R + 1;
+
+    return (TIMER4_TAILR_R - (value & 0xFFFF)) * prescale
+            + (prescale - 1 - ((value >> 16) & 0xFF));
+}
+
+/**
+ * @brief ISR handler for the TIMER4 wheel tick. Advances the wheel one slot,
+ * which calls every timer that expired, then stops TIMER4 if none are left.
+ *
+ */
+static void timer_wheelTickHandler(void) {
+    uint32_t entry = isrstat_enter(ISRSTAT_TIMER_WHEEL, timer_wheelLatency());
+
+    TIMER4_ICR_R = TIMER_ICR_TATOCINT; // Clear interrupt flag
+    wheel_tick();
+    timer_wheelClock();
+
+    isrstat_exit(ISRSTAT_TIMER_WHEEL, entry);
 }
@@ -15,13 +15,13 @@
 
 /**
  * @brief Initialize and start the clock at 0. If the clock is
- * already running on a call, reset the time count back to 0. Uses TIMER5.
+ * already running on a call, reset the time count back to 0. Uses WTIMER0.
  *
  */
 void timer_init(void);
 
 /**
- * @brief Stop the clock and free up TIMER5. Resets the value returned by
+ * @brief Stop the clock and free up WTIMER0. Resets the value returned by
  * getMillis() and getMicros().
  *
  */
@@ -39,6 +39,23 @@ void timer_pause(void);
  */
 void timer_resume(void);
 
+/**
+ * @brief Returns the number of system clock cycles counted since
+ * timer_init() was called. Reads the free-running WTIMER0 counter without
+ * disabling interrupts. Value does not roll over for thousands of years.
+ *
+ * @return uint64_t number of clock cycles since a call to timer_init()
+ */
+uint64_t timer_getTicks(void);
+
+/**
+ * @brief Returns the number of microseconds passed since a call to
+ * timer_init(). Value does not roll over during a mission.
+ *
+ * @return uint64_t number of microseconds since a call to timer_init()
+ */
+uint64_t timer_getMicros64(void);
+
 /**
  * @brief Returns the number milliseconds that have passed since startClock()
  * was called. Value rolls over after about 49 days.
@@ -50,69 +67,100 @@ unsigned int timer_getMillis(void);
 
 /**
  * @brief Returns the number of microseconds passed since a call to
- * startClock(). Value rolls over after about 71 minutes.
+ * startClock(). Value rolls over after about 71 minutes; use
+ * timer_getMicros64() for timestamps that must not wrap.
  *
  * @return unsigned int number of microseconds since a call to startClock()
  */
 unsigned int timer_getMicros(void);
 
 /**
- * @brief Pauses execution for the specified number of milliseconds.
+ * @brief Pauses execution for the specified number of milliseconds. The CPU
+ * sleeps with WFI until the deadline instead of polling the clock, and
+ * interrupt handlers still run while waiting.
  *
  * @param delay_time number of milliseconds to pause for
  */
 void timer_waitMillis(unsigned int delay_time);
 
 /**
- * @brief Pauses execution for the specified number of microseconds.
+ * @brief Sleeps with WFI until timer_getTicks() reaches the given deadline.
+ * Polls instead of sleeping when called from inside an ISR.
+ *
+ * @param deadline value of timer_getTicks() to wait for
+ */
+void timer_sleepUntil(uint64_t deadline);
+
+/**
+ * @brief Returns the total number of clock cycles the CPU spent asleep inside
+ * timer waits. CPU-busy time over an interval is the change in
+ * timer_getTicks() minus the change in this value.
+ *
+ * @return uint64_t clock cycles spent asleep since reset
+ */
+uint64_t timer_getSleepTicks(void);
+
+/**
+ * @brief Pauses execution for the specified number of microseconds. Timed by
+ * the WTIMER0 timebase, so it is exact at any system clock and does not drift
+ * when interrupts fire.
  *
  * @param delay_time number of microseconds to pause for
  */
 void timer_waitMicros(unsigned int delay_time);
 
-// TODO: Implement
+/**
+ * @brief Returns the measured cost of a call to timer_waitMicros(0), in clock
+ * cycles. Use it to judge how small a timing margin can safely be.
+ *
+ * @return unsigned int clock cycles of timer_waitMicros() call overhead
+ */
+unsigned int timer_getWaitMicrosOverhead(void);
+
 /**
  * @brief Sets up an interrupt to call the given function once every given
- * milliseconds. Uses TIMER4 for the countdown. Function f executes inside an
- * ISR, so keep the passed function as short as possible. Maximum interval time
- * is TODO: calculate
+ * milliseconds. Uses the TIMER4 software timer wheel, so many timers can run
+ * at once. Function f executes inside an ISR, so keep the passed function as
+ * short as possible. Maximum interval time is INT_MAX ms (about 24 days).
  *
  * @param f the function to call
  * @param millis the interval between calls
+ * @return handle to pass to timer_cancel(), or -1 if no timer is free
  */
-void timer_fireEvery(void (*f)(void), int millis);
+int timer_fireEvery(void (*f)(void), int millis);
 
-// TODO: Implement
 /**
  * @brief Sets up an interrupt to call the given function after the given number
- * of milliseconds. Uses TIMER4 for the countdown, and thus can only be used
- * when timer_fireEvery() and timer_fireFor() are not being used. Function f
- * executes inside an ISR and should be kept as short as possible.
+ * of milliseconds. Uses the TIMER4 software timer wheel and can be mixed freely
+ * with timer_fireEvery() and timer_fireFor(). Function f executes inside an ISR
+ * and should be kept as short as possible.
  *
  * @param f the function to call
  * @param millis milliseconds until call
+ * @return handle to pass to timer_cancel(), or -1 if no timer is free
  */
-void timer_fireOnce(void (*f)(void), int millis);
+int timer_fireOnce(void (*f)(void), int millis);
 
-// TODO: Implement
 /**
  * @brief Sets up an interrupt to call the given function after the given number
- * of milliseconds for the given number of times. Uses TIMER4 for the countdown,
- * and thus can only be used when fireOnce() and fireEvery() are not being used.
+ * of milliseconds for the given number of times. Uses the TIMER4 software timer
+ * wheel and can be mixed freely with timer_fireOnce() and timer_fireEvery().
  * Function f executes inside an ISR and should be kept as short as possible.
- * Maximum interval time is TODO: calculate
+ * Maximum interval time is INT_MAX ms (about 24 days).
  *
  * @param f the function to call
  * @param millis milliseconds until call
  * @param times number of times to call f
+ * @return handle to pass to timer_cancel(), or -1 if no timer is free
  */
-void timer_fireFor(void (*f)(void), int millis, int times);
+int timer_fireFor(void (*f)(void), int millis, int times);
 
 /**
- * @brief ISR handler to increment the timeout variable for tracking total
- * milliseconds
+ * @brief Stops a timer started by timer_fireEvery(), timer_fireOnce() or
+ * timer_fireFor(). Cancelling a timer that already finished does nothing.
  *
+ * @param handle value returned when the timer was started
  */
-static void timer_clockTickHandler();
+void timer_cancel(int handle);
 
 #endif /* TIMER_H_ */
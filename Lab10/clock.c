@@ -0,0 +1,39 @@
+/*
+ * clock.c
+ *
+ * System clock configuration
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include "clock.h"
+
+#define PLL_HZ 400000000UL // PLL output before the system divider
+
+void clock_init(void)
+{
+#if SYSCLK_HZ != 16000000UL
+    // Use RCC2 so the divider can run from the 400MHz PLL output
+    SYSCTL_RCC2_R |= SYSCTL_RCC2_USERCC2;
+
+    // Bypass the PLL while it is being set up
+    SYSCTL_RCC2_R |= SYSCTL_RCC2_BYPASS2;
+
+    // Turn on the 16MHz main oscillator and select it as the PLL input
+    SYSCTL_RCC_R &= ~SYSCTL_RCC_MOSCDIS;
+    SYSCTL_RCC_R = (SYSCTL_RCC_R & ~SYSCTL_RCC_XTAL_M) | SYSCTL_RCC_XTAL_16MHZ;
+    SYSCTL_RCC2_R = (SYSCTL_RCC2_R & ~SYSCTL_RCC2_OSCSRC2_M) | SYSCTL_RCC2_OSCSRC2_MO;
+
+    // Power up the PLL
+    SYSCTL_RCC2_R &= ~SYSCTL_RCC2_PWRDN2;
+
+    // Divide the 400MHz output directly, SYSDIV2:SYSDIV2LSB holds divisor - 1
+    SYSCTL_RCC2_R |= SYSCTL_RCC2_DIV400;
+    SYSCTL_RCC2_R = (SYSCTL_RCC2_R & ~(SYSCTL_RCC2_SYSDIV2_M | SYSCTL_RCC2_SYSDIV2LSB))
+                  | ((PLL_HZ / SYSCLK_HZ - 1) << 22);
+
+    // Wait for the PLL to lock, then switch over to it
+    while ((SYSCTL_RIS_R & SYSCTL_RIS_PLLLRIS) == 0) {};
+    SYSCTL_RCC2_R &= ~SYSCTL_RCC2_BYPASS2;
+#endif
+}
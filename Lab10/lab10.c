@@ -4,17 +4,23 @@
  *  Created on: Apr 17, 2025
  *      Author: jjbaccam
  */
+#include "clock.h"
 #include "Timer.h"
 #include "lcd.h"
 #include "button.h"
 #include "servo.h"
+#include "uart.h"
+#include "isrstat.h"
 
 int main(void) {
     // Initialize hardware components
+    clock_init(); // Must be first, every driver derives its timing from SYSCLK_HZ
     timer_init(); // Must be called before lcd_init(), which uses timer functions
     lcd_init();
     button_init();
     servo_init();
+    uart_interrupt_init();
+    isrstat_init();
 
     // Display welcome message
     lcd_printf("Lab 10: Servo\nControl with PWM\n\nInitializing...");
@@ -81,6 +87,10 @@ int main(void) {
                 // This won't execute due to infinite loop in servo_calibrate
                 lcd_printf("Select part:\nB1: Basic Movement\nB2: Button Control\nB3: Calibration");
             }
+            else if (button == 0x08) {
+                // Report interrupt latency and duration over UART1
+                isrstat_dump();
+            }
         }
     }
 
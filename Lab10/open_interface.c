@@ -16,6 +16,8 @@
  */
 
 #include "open_interface.h"
+#include "clock.h"
+#include "isrstat.h"
 
 #define OI_OPCODE_START 128
 #define OI_OPCODE_BAUD 129
@@ -374,10 +376,10 @@ void go_charge(void) {
 void oi_uartInit(void)
 {
     // Calculated Baudrate for 115200;
-    uint16_t iBRD = 0x08; // BRD=SYSCLK/((ClkDiv)(BaudRate)), HSE=0 ClkDiv=16,
-                          // BaudRate=115,200
+    uint16_t iBRD = CLOCK_UART_IBRD(115200); // BRD=SYSCLK/((ClkDiv)(BaudRate)), HSE=0 ClkDiv=16,
+                                             // BaudRate=115,200
     uint16_t fBRD =
-        44; // Fractional remainder is 0.6805, DIVFRAC = (.6805)(64)+0.5 = 44
+        CLOCK_UART_FBRD(115200); // Fractional remainder * 64, rounded
 
     SYSCTL_RCGCGPIO_R |= SYSCTL_RCGCGPIO_R2; // enable GPIO Port C
 
@@ -507,12 +509,16 @@ void oi_shutoff_init(void)
 
 void GPIOF_Handler(void)
 {
+    uint32_t entry = isrstat_enter(ISRSTAT_GPIOF, ISRSTAT_NO_LATENCY);
+
     if (GPIO_PORTF_RIS_R & BIT0) {
         // shutoff button was pressed, turn off OI
         oi_close();
 
         GPIO_PORTF_ICR_R |= BIT0; // clear interrupt
     }
+
+    isrstat_exit(ISRSTAT_GPIOF, entry);
 }
 
 /**
@@ -6,8 +6,15 @@
 
 #include "ping.h"
 #include "Timer.h"
+#include "clock.h"
+#include "isrstat.h"
 #include "driverlib/interrupt.h"
 
+// Sound travels 34000 cm/s and the echo covers the distance twice
+#define PING_CM_PER_TICK (17000.0f / SYSCLK_HZ)
+#define PING_MILLIS_PER_TICK (1000.0f / SYSCLK_HZ)
+#define PING_TIMEOUT_MS 40 // Longest echo is about 18.5ms, anything past this was lost
+
 // Global shared variables - only used within ping.c
 volatile enum {LOW, HIGH, DONE} state = LOW; // State of ping echo pulse
 volatile unsigned int g_start_time  = 0;  // Timer value at rising edge
@@ -101,6 +108,15 @@ void ping_trigger(void)
 
 void TIMER3B_Handler(void)
 {
+    uint32_t latency = ISRSTAT_NO_LATENCY;
+
+    // Both counters are 24 bits counting down, so the difference is the
+    // cycles from the captured edge to here
+    if ((TIMER3_MIS_R & 0x400) == 0x400) {
+        latency = (TIMER3_TBR_R - TIMER3_TBV_R) & 0xFFFFFF;
+    }
+    uint32_t entry = isrstat_enter(ISRSTAT_TIMER3B, latency);
+
     // Check if this is a capture event
     if ((TIMER3_MIS_R & 0x400) == 0x400) {
         // Clear the interrupt
@@ -125,13 +141,20 @@ void TIMER3B_Handler(void)
         TIMER3_ICR_R = 0x100;
         overflow_count++;
     }
+
+    isrstat_exit(ISRSTAT_TIMER3B, entry);
 }
 
 float ping_getDistance(void)
 {
+    unsigned int start = timer_getMillis();
+
     // Wait until a complete echo pulse has been measured
     while (state != DONE) {
-        // Wait for capture to complete
+        // Give up if the echo never arrives instead of hanging the caller
+        if (timer_getMillis() - start > PING_TIMEOUT_MS) {
+            return -1.0f;
+        }
     }
 
     // Calculate pulse width in clock cycles
@@ -149,7 +172,7 @@ float ping_getDistance(void)
     // Convert to distance in cm
     float distance;
 
-    distance = time * 0.0010625;
+    distance = time * PING_CM_PER_TICK;
 
     return distance;
 }
@@ -174,7 +197,7 @@ unsigned int ping_getPulseTime(void)
 float ping_getPulseMillis(void)
 {
     // Convert pulse time to milliseconds
-    return ping_getPulseTime() * 0.0000625;
+    return ping_getPulseTime() * PING_MILLIS_PER_TICK;
 }
 
 unsigned int ping_getOverflowCount(void)
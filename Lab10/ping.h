@@ -29,7 +29,7 @@ void TIMER3B_Handler(void);
 /**
  * @brief Calculate the distance in cm
  *
- * @return Distance in cm
+ * @return Distance in cm, or -1 if no echo came back within PING_TIMEOUT_MS
  */
 float ping_getDistance (void);
 
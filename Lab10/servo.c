@@ -7,12 +7,37 @@
 #include "servo.h"
 #include "button.h"
 #include "lcd.h"
+#include "clock.h"
+
+// PWM period of 20ms (50Hz) in system clock cycles
+#define SERVO_PERIOD_TICKS (SYSCLK_HZ / 50)
+
+// Calibration and match values are kept in 16MHz timer counts (1/16 us)
+// so calibrations carry over between clock settings
+#define SERVO_UNITS_HZ 16000000UL
 
 // Calibration values for the servo
 // Default values - these will be overwritten by calibration
 int right_calibration_value = 8000;
 int left_calibration_value = 34250;
 
+// Current match value, in 16MHz timer counts
+static int servo_match = 0;
+
+/**
+ * Set the PWM match value. The value is given in 16MHz timer counts and is
+ * scaled to the system clock, using the prescale match register for the bits
+ * above 16.
+ */
+static void servo_setMatch(int value)
+{
+    uint32_t ticks = (uint32_t)(((uint64_t)value * SYSCLK_HZ) / SERVO_UNITS_HZ);
+
+    servo_match = value;
+    TIMER1_TBPMR_R = ticks >> 16;
+    TIMER1_TBMATCHR_R = ticks & 0xFFFF;
+}
+
 void servo_init(void)
 {
     // Enable clock to Port B
@@ -44,8 +69,8 @@ void servo_init(void)
     TIMER1_CTL_R |= ~0b011111111111111;
 
     // Set load value for 20ms period (50Hz)
-    TIMER1_TBILR_R = 0x0000E200;
-    TIMER1_TBPR_R = 0x00000004;
+    TIMER1_TBILR_R = SERVO_PERIOD_TICKS & 0xFFFF;
+    TIMER1_TBPR_R = SERVO_PERIOD_TICKS >> 16;
 
     // Initial position at center (90 degrees)
     servo_move(90);
@@ -64,7 +89,7 @@ void servo_move(float degrees)
                      (int)((left_calibration_value - right_calibration_value) * degrees / 180.0);
 
     // Set the match value
-    TIMER1_TBMATCHR_R = matchValue;
+    servo_setMatch(matchValue);
 }
 
 void servo_button_control(void)
@@ -86,7 +111,7 @@ void servo_button_control(void)
 
     while (1) {
         // Get current position value
-        positionValue = TIMER1_TBMATCHR_R;
+        positionValue = servo_match;
 
         // Get button press
         button = button_getButton();
@@ -112,26 +137,26 @@ void servo_button_control(void)
 
             // Button 1: Move 1 degree clockwise
             if (button == 0x01 && positionValue > right_calibration_value) {
-                TIMER1_TBMATCHR_R -= slopeAngle;
+                servo_setMatch(servo_match - slopeAngle);
                 timer_waitMillis(100);  // Shorter delay for continuous movement
             }
 
             // Button 2: Move 5 degrees clockwise
             if (button == 0x02 && positionValue > right_calibration_value + slopeAngle*4) {
-                TIMER1_TBMATCHR_R -= slopeAngle*5;
+                servo_setMatch(servo_match - slopeAngle*5);
                 timer_waitMillis(100);  // Shorter delay for continuous movement
             }
 
             // Button 2: Move to 0 degrees if less than 5 degrees away
             if (button == 0x02 && positionValue < right_calibration_value + slopeAngle*4 &&
                 positionValue > right_calibration_value) {
-                TIMER1_TBMATCHR_R = right_calibration_value;
+                servo_setMatch(right_calibration_value);
                 timer_waitMillis(200);
             }
 
             // Button 4: Move to 5 degrees
             if (button == 0x08) {
-                TIMER1_TBMATCHR_R = right_calibration_value + slopeAngle*5;
+                servo_setMatch(right_calibration_value + slopeAngle*5);
                 timer_waitMillis(200);
             }
         }
@@ -145,26 +170,26 @@ void servo_button_control(void)
 
             // Button 1: Move 1 degree counterclockwise
             if (button == 0x01 && positionValue < left_calibration_value) {
-                TIMER1_TBMATCHR_R += slopeAngle;
+                servo_setMatch(servo_match + slopeAngle);
                 timer_waitMillis(100);  // Shorter delay for continuous movement
             }
 
             // Button 2: Move 5 degrees counterclockwise
             if (button == 0x02 && positionValue < left_calibration_value - slopeAngle*4) {
-                TIMER1_TBMATCHR_R += slopeAngle*5;
+                servo_setMatch(servo_match + slopeAngle*5);
                 timer_waitMillis(100);  // Shorter delay for continuous movement
             }
 
             // Button 2: Move to 180 degrees if less than 5 degrees away
             if (button == 0x02 && positionValue > left_calibration_value - slopeAngle*4 &&
                 positionValue < left_calibration_value) {
-                TIMER1_TBMATCHR_R = left_calibration_value;
+                servo_setMatch(left_calibration_value);
                 timer_waitMillis(200);
             }
 
             // Button 4: Move to 175 degrees
             if (button == 0x08) {
-                TIMER1_TBMATCHR_R = left_calibration_value - slopeAngle*5;
+                servo_setMatch(left_calibration_value - slopeAngle*5);
                 timer_waitMillis(200);
             }
         }
@@ -181,7 +206,7 @@ void servo_calibrate(void)
     button_init();
 
     // Start with center position
-    TIMER1_TBMATCHR_R = 22000; // Approximate center value
+    servo_setMatch(22000); // Approximate center value
 
     // First calibrate 0 degrees (right)
     lcd_printf("Calibrating 0 deg\nB1: Move left\nB2: Move right\nB4: Confirm");
@@ -191,29 +216,29 @@ void servo_calibrate(void)
 
         if (button == 0x01) {
             // Move left (increase match value)
-            TIMER1_TBMATCHR_R += 250;
+            servo_setMatch(servo_match + 250);
             timer_waitMillis(50);  // Short delay for continuous movement
 
             // Update display less frequently during continuous movement
             if (last_button != button) {
-                lcd_printf("Calibrating 0 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", TIMER1_TBMATCHR_R);
+                lcd_printf("Calibrating 0 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", servo_match);
                 last_button = button;
             }
         }
         else if (button == 0x02) {
             // Move right (decrease match value)
-            TIMER1_TBMATCHR_R -= 250;
+            servo_setMatch(servo_match - 250);
             timer_waitMillis(50);  // Short delay for continuous movement
 
             // Update display less frequently during continuous movement
             if (last_button != button) {
-                lcd_printf("Calibrating 0 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", TIMER1_TBMATCHR_R);
+                lcd_printf("Calibrating 0 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", servo_match);
                 last_button = button;
             }
         }
         else if (button == 0x08) {
             // Confirm 0 degree position
-            right_calibration_value = TIMER1_TBMATCHR_R;
+            right_calibration_value = servo_match;
             timer_waitMillis(200); // Debounce
             break;
         }
@@ -221,7 +246,7 @@ void servo_calibrate(void)
             // If no button is pressed but we were pressing one before,
             // update the display once more
             if (last_button != 0) {
-                lcd_printf("Calibrating 0 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", TIMER1_TBMATCHR_R);
+                lcd_printf("Calibrating 0 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", servo_match);
                 last_button = 0;
             }
         }
@@ -238,7 +263,7 @@ void servo_calibrate(void)
 
     // Now calibrate 180 degrees (left)
     last_button = 0;
-    TIMER1_TBMATCHR_R = 22000; // Reset to approximate center
+    servo_setMatch(22000); // Reset to approximate center
     lcd_printf("Calibrating 180 deg\nB1: Move left\nB2: Move right\nB4: Confirm");
 
     while (1) {
@@ -246,29 +271,29 @@ void servo_calibrate(void)
 
         if (button == 0x01) {
             // Move left (increase match value)
-            TIMER1_TBMATCHR_R += 250;
+            servo_setMatch(servo_match + 250);
             timer_waitMillis(50);  // Short delay for continuous movement
 
             // Update display less frequently during continuous movement
             if (last_button != button) {
-                lcd_printf("Calibrating 180 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", TIMER1_TBMATCHR_R);
+                lcd_printf("Calibrating 180 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", servo_match);
                 last_button = button;
             }
         }
         else if (button == 0x02) {
             // Move right (decrease match value)
-            TIMER1_TBMATCHR_R -= 250;
+            servo_setMatch(servo_match - 250);
             timer_waitMillis(50);  // Short delay for continuous movement
 
             // Update display less frequently during continuous movement
             if (last_button != button) {
-                lcd_printf("Calibrating 180 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", TIMER1_TBMATCHR_R);
+                lcd_printf("Calibrating 180 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", servo_match);
                 last_button = button;
             }
         }
         else if (button == 0x08) {
             // Confirm 180 degree position
-            left_calibration_value = TIMER1_TBMATCHR_R;
+            left_calibration_value = servo_match;
             timer_waitMillis(200); // Debounce
             break;
         }
@@ -276,7 +301,7 @@ void servo_calibrate(void)
             // If no button is pressed but we were pressing one before,
             // update the display once more
             if (last_button != 0) {
-                lcd_printf("Calibrating 180 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", TIMER1_TBMATCHR_R);
+                lcd_printf("Calibrating 180 deg\nValue: %d\nB1: Left B2: Right\nB4: Confirm", servo_match);
                 last_button = 0;
             }
         }
@@ -16,8 +16,8 @@
 
 // Calibration values for the servo
 // These will be set during calibration
-extern int right_calibration_value;  // Match value for 0 degrees (right)
-extern int left_calibration_value;   // Match value for 180 degrees (left)
+extern int right_calibration_value;  // Match value for 0 degrees (right), in 16MHz timer counts
+extern int left_calibration_value;   // Match value for 180 degrees (left), in 16MHz timer counts
 
 /**
  * Initialize the servo motor using PWM on Timer 1B (PB5)
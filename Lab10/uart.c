@@ -12,6 +12,8 @@
 #include <inc/tm4c123gh6pm.h>
 #include <stdint.h>
 #include <uart.h>
+#include "clock.h"
+#include "isrstat.h"
 #include "driverlib/interrupt.h" // for IntRegister, IntMasterEnable
 
 // Example global variables you can use if implementing a special command:
@@ -39,10 +41,11 @@ void uart_interrupt_init(void){
     // for PB0=Rx, PB1=Tx => bits [3:0] and [7:4] = 1 => 0x11
     GPIO_PORTB_PCTL_R |= 0x00000011;
 
-    //calculate baud rate
+    //calculate baud rate from the system clock
     // With 16 MHz clock:  Baud = 115,200 => IBRD=8, FBRD=44
-    uint16_t iBRD = 8;
-    uint16_t fBRD = 44;
+    // With 80 MHz clock:  Baud = 115,200 => IBRD=43, FBRD=26
+    uint16_t iBRD = CLOCK_UART_IBRD(115200);
+    uint16_t fBRD = CLOCK_UART_FBRD(115200);
 
     //turn off UART1 while setting it up
     UART1_CTL_R &= ~0x01;  //disable bit0 = UARTEN
@@ -128,6 +131,8 @@ void uart_sendStr(const char *data){
 void UART1_Handler(void)
 {
     char byte_received;
+    uint32_t entry = isrstat_enter(ISRSTAT_UART1, ISRSTAT_NO_LATENCY);
+
     //check if handler called due to RX event => bit4 in MIS
     if (UART1_MIS_R & 0x10)  // bit 4 indicates rx interrupt
     {
@@ -153,4 +158,5 @@ void UART1_Handler(void)
             }
         }
     }
+    isrstat_exit(ISRSTAT_UART1, entry);
 }
@@ -0,0 +1,206 @@
+/*
+ * wheel.c
+ *
+ * Hashed timer wheel, the hardware independent half of the TIMER4 software
+ * timers in Timer.c
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stddef.h>
+#include "wheel.h"
+
+#define WHEEL_UNLINKED 0xFF // slot of a finished timer waiting for its last call
+
+/**
+ * @brief One software timer. Armed timers are kept in a doubly linked list
+ * per wheel slot so they can be cancelled in O(1).
+ *
+ */
+typedef struct {
+    void (*callback)(void); // Function to call on expiry
+    unsigned int interval;  // Ticks between calls
+    unsigned int rounds;    // Full wheel turns left before expiry
+    int remaining;          // Calls left, -1 for forever
+    signed char next;       // Next timer in the same slot, -1 for none
+    signed char prev;       // Previous timer in the same slot, -1 for none
+    unsigned char slot;     // Wheel slot the timer is linked into
+    unsigned char generation; // Bumped on release so stale handles are ignored
+} soft_timer_t;
+
+/// A timer that expired this tick, called if its generation still matches
+typedef struct {
+    signed char index;
+    unsigned char generation;
+} wheel_due_t;
+
+static soft_timer_t _wheel_timers[WHEEL_MAX_TIMERS];
+static signed char _wheel_slots[WHEEL_SLOTS]; // Head of each slot's list
+static signed char _wheel_free = -1;          // Head of the free list
+static unsigned int _wheel_pos;               // Slot handled by the last tick
+static int _wheel_armed = 0;                  // Timers in use
+
+void wheel_init(void) {
+    int i;
+
+    for (i = 0; i < WHEEL_SLOTS; i++) {
+        _wheel_slots[i] = -1;
+    }
+    for (i = 0; i < WHEEL_MAX_TIMERS; i++) {
+        _wheel_timers[i].callback = 0;
+        _wheel_timers[i].next = (i + 1 < WHEEL_MAX_TIMERS) ? i + 1 : -1;
+    }
+    _wheel_free = 0;
+    _wheel_pos = 0;
+    _wheel_armed = 0;
+}
+
+/**
+ * @brief Link a timer into the slot that expires the given number of ticks
+ * from now.
+ *
+ */
+static void wheel_link(int index, unsigned int millis) {
+    soft_timer_t *t = &_wheel_timers[index];
+    unsigned int slot;
+
+    if (millis == 0) {
+        millis = 1; // Soonest possible expiry is the next tick
+    }
+
+    slot = (_wheel_pos + millis) & (WHEEL_SLOTS - 1);
+    t->rounds = (millis - 1) / WHEEL_SLOTS;
+    t->slot = slot;
+    t->prev = -1;
+    t->next = _wheel_slots[slot];
+    if (t->next >= 0) {
+        _wheel_timers[t->next].prev = index;
+    }
+    _wheel_slots[slot] = index;
+}
+
+/**
+ * @brief Remove a timer from its slot list.
+ *
+ */
+static void wheel_unlink(int index) {
+    soft_timer_t *t = &_wheel_timers[index];
+
+    if (t->prev >= 0) {
+        _wheel_timers[t->prev].next = t->next;
+    } else {
+        _wheel_slots[t->slot] = t->next;
+    }
+    if (t->next >= 0) {
+        _wheel_timers[t->next].prev = t->prev;
+    }
+    t->slot = WHEEL_UNLINKED;
+}
+
+/**
+ * @brief Return an unlinked timer to the free list.
+ *
+ */
+static void wheel_release(int index) {
+    soft_timer_t *t = &_wheel_timers[index];
+
+    t->callback = 0;
+    t->generation++;
+    t->next = _wheel_free;
+    _wheel_free = index;
+    _wheel_armed--;
+}
+
+int wheel_arm(void (*f)(void), unsigned int millis, int times) {
+    int index = _wheel_free;
+    soft_timer_t *t;
+
+    if (!f || times == 0 || index < 0) {
+        return -1;
+    }
+
+    t = &_wheel_timers[index];
+    _wheel_free = t->next;
+
+    t->callback = f;
+    t->interval = millis;
+    t->remaining = times;
+    wheel_link(index, millis);
+    _wheel_armed++;
+
+    return (t->generation << 8) | index;
+}
+
+int wheel_cancel(int handle) {
+    int index = handle & 0xFF;
+    soft_timer_t *t;
+
+    if (handle < 0 || index >= WHEEL_MAX_TIMERS) {
+        return 0;
+    }
+
+    t = &_wheel_timers[index];
+    if (!t->callback || t->generation != ((handle >> 8) & 0xFF)) {
+        return 0;
+    }
+
+    if (t->slot != WHEEL_UNLINKED) {
+        wheel_unlink(index);
+    }
+    wheel_release(index);
+    return 1;
+}
+
+void wheel_tick(void) {
+    wheel_due_t due[WHEEL_MAX_TIMERS];
+    int num_due = 0;
+    int index;
+    int i;
+
+    _wheel_pos = (_wheel_pos + 1) & (WHEEL_SLOTS - 1);
+
+    // Re-arm every timer that expired before calling any of them, so
+    // callbacks see a consistent wheel and may arm or cancel timers
+    index = _wheel_slots[_wheel_pos];
+    while (index >= 0) {
+        soft_timer_t *t = &_wheel_timers[index];
+        int next = t->next;
+
+        if (t->rounds > 0) {
+            t->rounds--;
+        } else {
+            due[num_due].index = index;
+            due[num_due].generation = t->generation;
+            num_due++;
+
+            wheel_unlink(index);
+            if (t->remaining > 0) {
+                t->remaining--;
+            }
+            if (t->remaining != 0) {
+                wheel_link(index, t->interval);
+            }
+            // A finished timer stays allocated until its last call, so a
+            // callback before it can still cancel it
+        }
+        index = next;
+    }
+
+    for (i = 0; i < num_due; i++) {
+        soft_timer_t *t = &_wheel_timers[due[i].index];
+
+        if (!t->callback || t->generation != due[i].generation) {
+            continue; // Cancelled by an earlier callback this tick
+        }
+        t->callback();
+
+        // Release a finished timer unless its own callback cancelled it
+        if (t->callback && t->generation == due[i].generation && t->remaining == 0) {
+            wheel_release(due[i].index);
+        }
+    }
+}
+
+int wheel_armed(void) {
+    return _wheel_armed;
+}
@@ -0,0 +1,51 @@
+/*
+ * wheel.h
+ *
+ * Hashed timer wheel behind timer_fireEvery(), timer_fireOnce() and
+ * timer_fireFor(). Armed timers are kept in a doubly linked list per slot,
+ * so arming and cancelling are O(1) and a tick only looks at one slot.
+ *
+ * The wheel knows nothing about TIMER4: Timer.c calls wheel_tick() from its
+ * 1ms interrupt and starts or stops the timer as wheel_armed() changes, so
+ * the wheel can be driven by a simulated tick on a host. Callers must keep
+ * wheel_tick() from running during wheel_arm() and wheel_cancel().
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef WHEEL_H_
+#define WHEEL_H_
+
+#define WHEEL_SLOTS 64      // Slots in the wheel, must be a power of 2
+#define WHEEL_MAX_TIMERS 32 // Number of software timers that can be armed at once
+
+/// Empty every slot and build the free list
+void wheel_init(void);
+
+/**
+ * Arm a timer that calls f every millis ticks, times times.
+ * @param f Function to call on expiry
+ * @param millis Ticks until the first call and between calls, 0 is the next tick
+ * @param times Number of calls, -1 for forever
+ * @return handle for wheel_cancel(), or -1 if no timer is free
+ */
+int wheel_arm(void (*f)(void), unsigned int millis, int times);
+
+/**
+ * Disarm a timer. Handles of timers that already finished are ignored, even
+ * once their slot has been reused.
+ * @return 1 if the timer was armed and is now cancelled, 0 otherwise
+ */
+int wheel_cancel(int handle);
+
+/**
+ * Advance one tick and call every timer that expired. A timer cancelled by
+ * an earlier callback in the same tick is not called. Callbacks may arm and
+ * cancel timers.
+ */
+void wheel_tick(void);
+
+/// Returns the number of armed timers, the tick can stop while it is 0
+int wheel_armed(void);
+
+#endif /* WHEEL_H_ */
@@ -15,6 +15,11 @@
 // GPIO_PORTE_DATA_R -- Name of the memory mapped register for GPIO Port E,
 // which is connected to the push buttons
 #include "button.h"
+#include "driverlib/interrupt.h" // for IntRegister
+
+static volatile uint8_t button_event = 0; // Buttons pressed since the last button_getEvent()
+
+static void button_handler(void);
 
 
 /**
@@ -115,3 +120,58 @@ uint8_t button_getButton() {
 
 	return 0; // EDIT ME
 }
+
+
+
+/**
+ * Interrupt on the falling edge of every button, so a press can wake the CPU
+ * from sleep. Presses are latched until button_getEvent() reads them.
+ */
+void button_interruptInit() {
+	button_init();
+
+	GPIO_PORTE_IS_R &= ~0x0F;   // Edge sensitive
+	GPIO_PORTE_IBE_R &= ~0x0F;  // Single edge
+	GPIO_PORTE_IEV_R &= ~0x0F;  // Falling edge, buttons read low when pushed
+	GPIO_PORTE_ICR_R = 0x0F;    // Clear stale edges
+	GPIO_PORTE_IM_R |= 0x0F;    // Unmask PE0-3
+
+	NVIC_PRI1_R = (NVIC_PRI1_R & ~NVIC_PRI1_INT4_M) | (5 << NVIC_PRI1_INT4_S); // Priority 5
+	NVIC_EN0_R |= (1 << 4);     // Enable GPIOE interrupts (IRQ 4)
+	IntRegister(INT_GPIOE, button_handler);
+}
+
+
+
+/**
+ * Returns the buttons pressed since the last call, one bit per button in the
+ * same positions as button_getButton(), and clears them.
+ */
+uint8_t button_getEvent() {
+	uint8_t event;
+
+	GPIO_PORTE_IM_R &= ~0x0F;   // Keep the handler out while reading and clearing
+	event = button_event;
+	button_event = 0;
+	GPIO_PORTE_IM_R |= 0x0F;
+
+	return event;
+}
+
+
+
+/**
+ * Returns nonzero if a button was pressed since the last button_getEvent()
+ */
+uint8_t button_hasEvent() {
+	return button_event != 0;
+}
+
+
+
+static void button_handler(void) {
+	uint8_t edges = GPIO_PORTE_MIS_R & 0x0F;
+
+	GPIO_PORTE_ICR_R = edges;   // Clear the edges being handled
+	button_event |= edges;
+}
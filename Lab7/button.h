@@ -21,5 +21,16 @@ void button_init();
 ///Returns highest value button being pressed, 0 if no button pressed
 uint8_t button_getButton();
 
+///Interrupt on button presses so they wake the CPU from sleep
+void button_interruptInit();
+
+///Non-blocking call
+///Returns the buttons pressed since the last call, one bit each, and clears them
+uint8_t button_getEvent();
+
+///Non-blocking call
+///Returns nonzero if button_getEvent() has a press to report
+uint8_t button_hasEvent();
+
 
 #endif /* BUTTON_H_ */
@@ -0,0 +1,269 @@
+/*
+ * chan.c
+ *
+ * Logical channels over UART1 with priorities, see chan.h
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stdio.h>
+#include <inc/tm4c123gh6pm.h>
+#include "driverlib/cpu.h" // for CPUcpsid, CPUcpsie, CPUprimask
+#include "chan.h"
+#include "Timer.h"
+#include "uart.h"
+
+#if CHAN_MAX_MESSAGE > 255
+#error "CHAN_MAX_MESSAGE must fit the one byte length in front of each message"
+#endif
+
+/// Queue of whole messages, each stored as a length byte then the bytes.
+/// Indices run freely and are masked on use.
+typedef struct {
+    char *buffer;
+    uint32_t mask;
+    volatile uint32_t head; // Next free byte, advanced by writers
+    volatile uint32_t tail; // Next message to send, advanced by chan_pump()
+    chan_stats_t stats;
+} chan_queue_t;
+
+static char command_buffer[CHAN_COMMAND_QUEUE];
+static char console_buffer[CHAN_CONSOLE_QUEUE];
+static char telemetry_buffer[CHAN_TELEMETRY_QUEUE];
+
+static chan_queue_t queues[CHAN_NUM_CHANNELS] = {
+    { command_buffer, CHAN_COMMAND_QUEUE - 1 },
+    { console_buffer, CHAN_CONSOLE_QUEUE - 1 },
+    { telemetry_buffer, CHAN_TELEMETRY_QUEUE - 1 },
+};
+
+static const char *const names[CHAN_NUM_CHANNELS] = { "command", "console", "telemetry" };
+
+static uint32_t stats_start_ms = 0;
+
+// Queue a writer is sleeping on and the room it needs
+static chan_queue_t *waiting;
+static uint32_t waiting_need;
+
+static uint32_t chan_space(const chan_queue_t *q)
+{
+    return q->mask + 1 - (q->head - q->tail);
+}
+
+static int chan_hasRoom(void)
+{
+    return chan_space(waiting) >= waiting_need;
+}
+
+static int chan_empty(void)
+{
+    return !chan_pending();
+}
+
+// Sleeping isn't possible in an ISR or with interrupts masked
+static int chan_canWait(void)
+{
+    return !CPUprimask() && !(NVIC_INT_CTRL_R & NVIC_INT_CTRL_VEC_ACT_M);
+}
+
+// Move whole messages into the UART TX ring, highest priority first, while
+// they fit in CHAN_TX_WINDOW. Runs from UART1_Handler each time the TX FIFO
+// drains and from writers, so it holds interrupts off while it works.
+static void chan_pump(void)
+{
+    uint32_t was_masked = CPUcpsid();
+    int c = 0;
+
+    while (c < CHAN_NUM_CHANNELS) {
+        chan_queue_t *q = &queues[c];
+        uint32_t len, start, first, pending;
+
+        if (q->head == q->tail) {
+            c++;
+            continue;
+        }
+
+        // Lower priority messages wait too, or they would take the room
+        len = (uint8_t)q->buffer[q->tail & q->mask];
+        pending = uart_txPending();
+        if (pending != 0 && pending + len > CHAN_TX_WINDOW) {
+            break;
+        }
+
+        start = (q->tail + 1) & q->mask;
+        first = q->mask + 1 - start;
+        if (first > len) {
+            first = len;
+        }
+        uart_sendBuf(q->buffer + start, first);
+        if (first < len) {
+            uart_sendBuf(q->buffer, len - first);
+        }
+        q->tail += 1 + len;
+        q->stats.sent += len;
+    }
+
+    if (!was_masked) {
+        CPUcpsie();
+    }
+}
+
+void chan_init(void)
+{
+    stats_start_ms = timer_getMillis();
+    uart_setTxRefill(chan_pump);
+}
+
+// Copy one message into a queue, sleeping for room if wait is set
+// Returns 1 if it was queued, 0 if it was dropped
+static int chan_put(chan_queue_t *q, const char *data, uint32_t len, int wait)
+{
+    uint32_t need = 1 + len;
+    uint32_t was_masked, at, i;
+
+    while (1) {
+        was_masked = CPUcpsid();
+        if (chan_space(q) >= need) {
+            break;
+        }
+        if (!wait || !chan_canWait()) {
+            q->stats.dropped++;
+            if (!was_masked) {
+                CPUcpsie();
+            }
+            return 0;
+        }
+        if (!was_masked) {
+            CPUcpsie();
+        }
+
+        chan_pump();
+        waiting = q;
+        waiting_need = need;
+        timer_idleUntil(UINT64_MAX, chan_hasRoom);
+    }
+
+    at = q->head;
+    q->buffer[at & q->mask] = (char)len;
+    for (i = 0; i < len; i++) {
+        q->buffer[(at + 1 + i) & q->mask] = data[i];
+    }
+    q->head = at + need;
+
+    q->stats.messages++;
+    q->stats.bytes += len;
+    if (q->head - q->tail > q->stats.peak) {
+        q->stats.peak = q->head - q->tail;
+    }
+    if (!was_masked) {
+        CPUcpsie();
+    }
+    return 1;
+}
+
+int chan_write(chan_id_t chan, const char *data, int len)
+{
+    chan_queue_t *q = &queues[chan];
+    int wait = (chan != CHAN_TELEMETRY);
+    int done = 0;
+
+    if (!wait && len > CHAN_MAX_MESSAGE) {
+        q->stats.dropped++;
+        return 0;
+    }
+
+    while (done < len) {
+        int part = len - done < CHAN_MAX_MESSAGE ? len - done : CHAN_MAX_MESSAGE;
+        if (!chan_put(q, data + done, part, wait)) {
+            chan_pump();
+            return 0;
+        }
+        done += part;
+    }
+
+    chan_pump();
+    return len;
+}
+
+void chan_writeStr(chan_id_t chan, const char *str)
+{
+    int len = 0;
+    while (str[len] != '\0') {
+        len++;
+    }
+    chan_write(chan, str, len);
+}
+
+int chan_pending(void)
+{
+    int c;
+    for (c = 0; c < CHAN_NUM_CHANNELS; c++) {
+        if (queues[c].head != queues[c].tail) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void chan_flush(void)
+{
+    while (chan_pending()) {
+        chan_pump();
+        timer_idleUntil(UINT64_MAX, chan_empty);
+    }
+    uart_txFlush();
+}
+
+void chan_getStats(chan_id_t chan, chan_stats_t *stats)
+{
+    uint32_t was_masked = CPUcpsid();
+    *stats = queues[chan].stats;
+    if (!was_masked) {
+        CPUcpsie();
+    }
+}
+
+void chan_resetStats(void)
+{
+    uint32_t was_masked = CPUcpsid();
+    int c;
+    for (c = 0; c < CHAN_NUM_CHANNELS; c++) {
+        chan_queue_t *q = &queues[c];
+        q->stats.messages = 0;
+        q->stats.bytes = 0;
+        q->stats.sent = 0;
+        q->stats.dropped = 0;
+        q->stats.peak = q->head - q->tail;
+    }
+    stats_start_ms = timer_getMillis();
+    if (!was_masked) {
+        CPUcpsie();
+    }
+}
+
+void chan_dump(void)
+{
+    uint32_t elapsed = timer_getMillis() - stats_start_ms;
+    char buffer[100];
+    int c;
+
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+
+    uart_sendStr("\r\nChannel    Messages      Bytes       Sent  Dropped  Peak  Bytes/s\r\n");
+    uart_sendStr("-----------------------------------------------------------------\r\n");
+
+    for (c = 0; c < CHAN_NUM_CHANNELS; c++) {
+        chan_stats_t stats;
+        chan_getStats((chan_id_t)c, &stats);
+        sprintf(buffer, "%-10s %8lu %10lu %10lu %8lu %5lu %8lu\r\n", names[c],
+                (unsigned long)stats.messages, (unsigned long)stats.bytes,
+                (unsigned long)stats.sent, (unsigned long)stats.dropped,
+                (unsigned long)stats.peak,
+                (unsigned long)((uint64_t)stats.sent * 1000 / elapsed));
+        uart_sendStr(buffer);
+    }
+
+    uart_sendStr("\r\n");
+}
@@ -0,0 +1,89 @@
+/*
+ * chan.h
+ *
+ * Logical channels over UART1. Command replies, console text and binary
+ * telemetry each get their own queue of whole messages. The UART TX
+ * interrupt pulls from the queues in priority order, keeping at most
+ * CHAN_TX_WINDOW bytes in the driver's ring, so a command reply only ever
+ * waits behind that much console or telemetry output.
+ *
+ * Messages are never split or interleaved on the wire, which keeps every
+ * COBS telemetry frame whole between console text. Framing per channel:
+ *   CHAN_COMMAND    text replies, never dropped, highest priority
+ *   CHAN_CONSOLE    text and log frames, never dropped
+ *   CHAN_TELEMETRY  COBS frames from telemetry.c, dropped whole when its
+ *                   queue is full
+ * Writers to the never-dropped channels sleep until there is room, except
+ * in an ISR, where the message is dropped and counted.
+ *
+ * Bytes written straight to uart_sendStr() (echo, the *_dump() tables)
+ * bypass the channels and go out after whatever is already in the ring.
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef CHAN_H_
+#define CHAN_H_
+
+#include <stdint.h>
+
+/// Channels, in priority order
+typedef enum {
+    CHAN_COMMAND,
+    CHAN_CONSOLE,
+    CHAN_TELEMETRY,
+    CHAN_NUM_CHANNELS
+} chan_id_t;
+
+/// Most bytes the channels keep queued in the UART TX ring at once
+#define CHAN_TX_WINDOW 64
+
+/// Longest message, longer text is sent as several messages
+#define CHAN_MAX_MESSAGE 128
+
+/// Queue sizes in bytes, must be powers of 2
+#define CHAN_COMMAND_QUEUE   256
+#define CHAN_CONSOLE_QUEUE   1024
+#define CHAN_TELEMETRY_QUEUE 1024
+
+/// Counters per channel since chan_resetStats()
+typedef struct {
+    uint32_t messages; // Messages queued
+    uint32_t bytes;    // Bytes in those messages
+    uint32_t sent;     // Bytes handed to the UART driver
+    uint32_t dropped;  // Messages thrown away because the queue was full
+    uint32_t peak;     // Highest queue occupancy in bytes, including a length byte per message
+} chan_stats_t;
+
+/// Hook the channels into the UART TX interrupt, call after uart_interrupt_init()
+void chan_init(void);
+
+/**
+ * Queue one message.
+ * @param chan Channel to send on
+ * @param data Message bytes, copied before returning
+ * @param len Message length. Text longer than CHAN_MAX_MESSAGE is split,
+ *            a longer telemetry message is dropped.
+ * @return len, or 0 if the message was dropped
+ */
+int chan_write(chan_id_t chan, const char *data, int len);
+
+/// Queue a string, see chan_write()
+void chan_writeStr(chan_id_t chan, const char *str);
+
+/// Returns 1 while any channel has messages waiting
+int chan_pending(void);
+
+/// Wait until every channel and the UART have sent everything
+void chan_flush(void);
+
+/// Copy one channel's counters
+void chan_getStats(chan_id_t chan, chan_stats_t *stats);
+
+/// Clear every channel's counters and restart the throughput clock
+void chan_resetStats(void);
+
+/// Send the counters and throughput of every channel over UART1
+void chan_dump(void);
+
+#endif /* CHAN_H_ */
@@ -0,0 +1,49 @@
+/*
+ * clock.h
+ *
+ * System clock configuration. Every baud divisor, timer prescaler and
+ * conversion constant that depends on the CPU clock is derived from
+ * SYSCLK_HZ here, so changing the clock is a one line change.
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include <inc/tm4c123gh6pm.h>
+#include <stdint.h>
+
+// System clock in Hz. 16MHz runs straight from the PIOSC; anything else is
+// generated by the 400MHz PLL and must divide it evenly (80MHz max).
+// Lab 7 stays at 16MHz because libcybotScan drives the servo and PING with
+// timing compiled for the 16MHz clock.
+#ifndef SYSCLK_HZ
+#define SYSCLK_HZ 16000000UL
+#endif
+
+#if (SYSCLK_HZ != 16000000UL) && ((400000000UL % SYSCLK_HZ) != 0 || SYSCLK_HZ > 80000000UL)
+#error "SYSCLK_HZ must be 16MHz or 400MHz / n with n >= 5"
+#endif
+
+// System clock cycles per microsecond and per millisecond
+#define CLOCK_TICKS_PER_MICRO (SYSCLK_HZ / 1000000UL)
+#define CLOCK_TICKS_PER_MILLI (SYSCLK_HZ / 1000UL)
+
+// Prescaler that makes a 16-bit general purpose timer count once per microsecond
+#define CLOCK_TIMER_PRESCALE_1US (CLOCK_TICKS_PER_MICRO - 1)
+
+// UART baud divisor in 1/64ths, rounded: BRD = SYSCLK / (16 * baud)
+#define CLOCK_UART_DIV64(baud) (((SYSCLK_HZ * 8UL / (baud)) + 1) / 2)
+// Integer part of the baud divisor for UARTIBRD
+#define CLOCK_UART_IBRD(baud) (CLOCK_UART_DIV64(baud) >> 6)
+// Fractional part of the baud divisor for UARTFBRD
+#define CLOCK_UART_FBRD(baud) (CLOCK_UART_DIV64(baud) & 0x3F)
+
+/**
+ * Bring the system clock up to SYSCLK_HZ. Must be the first call in main(),
+ * before any peripheral is initialized.
+ */
+void clock_init(void);
+
+#endif /* CLOCK_H_ */
@@ -0,0 +1,235 @@
+/*
+ * cmd.c
+ *
+ * Table-driven command interpreter for the UART1 console
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "cmd.h"
+#include "chan.h"
+#include "uart.h"
+
+static const cmd_t *commands = NULL;
+static int num_commands = 0;
+static const cmd_param_t *params = NULL;
+static int num_params = 0;
+
+static int cmd_help(int argc, char *argv[]);
+static int cmd_get(int argc, char *argv[]);
+static int cmd_set(int argc, char *argv[]);
+
+// Always available, searched after the registered table
+static const cmd_t builtins[] = {
+    { "help", "",              "List the commands",               cmd_help },
+    { "get",  "[name]",        "Show one or every parameter",     cmd_get },
+    { "set",  "<name> <value>", "Change a parameter until reset", cmd_set },
+};
+
+#define NUM_BUILTINS ((int)(sizeof(builtins) / sizeof(builtins[0])))
+
+void cmd_init(const cmd_t *command_table, int command_count,
+              const cmd_param_t *param_table, int param_count)
+{
+    commands = command_table;
+    num_commands = command_count;
+    params = param_table;
+    num_params = param_count;
+}
+
+int cmd_poll(void)
+{
+    char line[UART_LINE_SIZE];
+
+    if (uart_getLine(line, sizeof(line)) < 0) {
+        return 0;
+    }
+    cmd_execute(line);
+    return 1;
+}
+
+static const cmd_t *find_command(const char *name)
+{
+    int i;
+    for (i = 0; i < num_commands; i++) {
+        if (strcmp(commands[i].name, name) == 0) {
+            return &commands[i];
+        }
+    }
+    for (i = 0; i < NUM_BUILTINS; i++) {
+        if (strcmp(builtins[i].name, name) == 0) {
+            return &builtins[i];
+        }
+    }
+    return NULL;
+}
+
+void cmd_reply(const char *str)
+{
+    chan_writeStr(CHAN_COMMAND, str);
+}
+
+static const cmd_param_t *find_param(const char *name)
+{
+    int i;
+    for (i = 0; i < num_params; i++) {
+        if (strcmp(params[i].name, name) == 0) {
+            return &params[i];
+        }
+    }
+    return NULL;
+}
+
+int cmd_execute(char *line)
+{
+    char *argv[CMD_MAX_ARGS];
+    char buffer[UART_LINE_SIZE + 32];
+    int argc = 0;
+    const cmd_t *cmd;
+    int result;
+
+    // Split on spaces and tabs in place
+    while (*line != '\0') {
+        while (*line == ' ' || *line == '\t') {
+            *line++ = '\0';
+        }
+        if (*line == '\0') {
+            break;
+        }
+        if (argc == CMD_MAX_ARGS) {
+            cmd_reply("Too many arguments\r\n");
+            return CMD_USAGE;
+        }
+        argv[argc++] = line;
+        while (*line != '\0' && *line != ' ' && *line != '\t') {
+            line++;
+        }
+    }
+    if (argc == 0) {
+        return CMD_OK;
+    }
+
+    cmd = find_command(argv[0]);
+    if (cmd == NULL) {
+        snprintf(buffer, sizeof(buffer), "Unknown command '%s', type help for a list\r\n", argv[0]);
+        cmd_reply(buffer);
+        return CMD_USAGE;
+    }
+
+    result = cmd->run(argc, argv);
+    if (result == CMD_USAGE) {
+        snprintf(buffer, sizeof(buffer), "Usage: %s %s\r\n", cmd->name, cmd->usage);
+        cmd_reply(buffer);
+    }
+    return result;
+}
+
+int cmd_parseInt(const char *str, int32_t *value)
+{
+    const char *digits = str;
+    char *end;
+    long parsed;
+    int base = 10;
+
+    // Base 0 would read a leading zero as octal, only 0x switches base
+    if (*digits == '+' || *digits == '-') {
+        digits++;
+    }
+    if (digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+        base = 16;
+    }
+
+    errno = 0;
+    parsed = strtol(str, &end, base);
+    if (end == str || *end != '\0' || errno == ERANGE
+            || parsed > INT32_MAX || parsed < INT32_MIN) {
+        return -1;
+    }
+    *value = (int32_t)parsed;
+    return 0;
+}
+
+static void print_command(const cmd_t *cmd)
+{
+    char buffer[100];
+    snprintf(buffer, sizeof(buffer), "  %-6s %-16s %s\r\n", cmd->name, cmd->usage, cmd->help);
+    cmd_reply(buffer);
+}
+
+void cmd_printHelp(void)
+{
+    int i;
+    cmd_reply("Commands:\r\n");
+    for (i = 0; i < num_commands; i++) {
+        print_command(&commands[i]);
+    }
+    for (i = 0; i < NUM_BUILTINS; i++) {
+        print_command(&builtins[i]);
+    }
+}
+
+static int cmd_help(int argc, char *argv[])
+{
+    cmd_printHelp();
+    return CMD_OK;
+}
+
+static void print_param(const cmd_param_t *param)
+{
+    char buffer[120];
+    snprintf(buffer, sizeof(buffer), "  %-12s %8ld  (%ld to %ld) %s\r\n",
+             param->name, (long)*param->value, (long)param->min, (long)param->max, param->help);
+    cmd_reply(buffer);
+}
+
+static int cmd_get(int argc, char *argv[])
+{
+    const cmd_param_t *param;
+    int i;
+
+    if (argc > 2) {
+        return CMD_USAGE;
+    }
+    if (argc == 1) {
+        for (i = 0; i < num_params; i++) {
+            print_param(&params[i]);
+        }
+        return CMD_OK;
+    }
+
+    param = find_param(argv[1]);
+    if (param == NULL) {
+        cmd_reply("No such parameter, type get for a list\r\n");
+        return CMD_OK;
+    }
+    print_param(param);
+    return CMD_OK;
+}
+
+static int cmd_set(int argc, char *argv[])
+{
+    const cmd_param_t *param;
+    int32_t value;
+
+    if (argc != 3) {
+        return CMD_USAGE;
+    }
+    param = find_param(argv[1]);
+    if (param == NULL) {
+        cmd_reply("No such parameter, type get for a list\r\n");
+        return CMD_OK;
+    }
+    if (cmd_parseInt(argv[2], &value) != 0 || value < param->min || value > param->max) {
+        print_param(param);
+        cmd_reply("Not a number in range, parameter unchanged\r\n");
+        return CMD_OK;
+    }
+
+    *param->value = value;
+    print_param(param);
+    return CMD_OK;
+}
@@ -0,0 +1,95 @@
+/*
+ * cmd.h
+ *
+ * Table-driven command interpreter for the UART1 console. cmd_poll() takes
+ * the next line assembled by uart_getLine(), splits it into words and runs
+ * the command named by the first word with the rest as arguments:
+ *
+ *     scan 20 160 1
+ *     set ir_thresh 900
+ *
+ * Integer parameters registered with cmd_init() can be listed with "get"
+ * and changed with "set" without reflashing. "help" lists the commands.
+ *
+ * cmd_poll() never blocks, so the main loop can keep running motion and
+ * tasks between commands.
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef CMD_H_
+#define CMD_H_
+
+#include <stdint.h>
+
+/// Most words in one command line, including the command name
+#define CMD_MAX_ARGS 8
+
+/// Handler return values
+#define CMD_OK     0  // Command ran
+#define CMD_USAGE  -1 // Wrong arguments, the usage line is printed
+
+/**
+ * Command handler.
+ * @param argc Number of words, argv[0] is the command name
+ * @param argv Words of the line, split on spaces
+ * @return CMD_OK, or CMD_USAGE to print the usage line
+ */
+typedef int (*cmd_handler_t)(int argc, char *argv[]);
+
+/// One entry in the command table
+typedef struct {
+    const char *name;  // First word of the line
+    const char *usage; // Arguments printed by "help", "" if none
+    const char *help;  // One line description
+    cmd_handler_t run;
+} cmd_t;
+
+/// An integer that "set" can change, checked against min and max
+typedef struct {
+    const char *name;
+    int32_t *value;
+    int32_t min;
+    int32_t max;
+    const char *help;
+} cmd_param_t;
+
+/**
+ * Register the command and parameter tables. The tables are used in place
+ * and must stay valid, normally they are static const arrays.
+ * @param commands Command table, searched in order before the built-ins
+ * @param num_commands Entries in commands
+ * @param params Parameters for "get" and "set", may be NULL
+ * @param num_params Entries in params
+ */
+void cmd_init(const cmd_t *commands, int num_commands,
+              const cmd_param_t *params, int num_params);
+
+/**
+ * Run the next complete line received over UART1, if there is one.
+ * Never blocks.
+ * @return 1 if a line was handled, 0 if no complete line was ready
+ */
+int cmd_poll(void);
+
+/**
+ * Split a line into words and run the matching command. The line is
+ * modified in place.
+ * @return the handler's result, or CMD_USAGE for an unknown command
+ */
+int cmd_execute(char *line);
+
+/**
+ * Parse a decimal or 0x hexadecimal integer, with an optional sign. A
+ * leading zero is still decimal.
+ * @return 0 on success, -1 if str isn't a whole number or is out of range
+ */
+int cmd_parseInt(const char *str, int32_t *value);
+
+/// Send a reply on CHAN_COMMAND, ahead of console text and telemetry
+void cmd_reply(const char *str);
+
+/// Print every command with its usage and description
+void cmd_printHelp(void);
+
+#endif /* CMD_H_ */
@@ -0,0 +1,57 @@
+/*
+ * fmt.h
+ *
+ * Allocation-free formatting of strings, integers and fixed-point decimals
+ * into a caller-supplied buffer. Used instead of sprintf() with %f on hot
+ * paths, so no float printf code runs there. Output is always terminated
+ * and is cut short rather than overflowing the buffer.
+ *
+ *     fmt_t f;
+ *     fmt_init(&f, buffer, sizeof(buffer));
+ *     fmt_int(&f, angle, 3);          // "%3d"
+ *     fmt_float(&f, distance, 1, 6);  // "%6.1f"
+ *     fmt_fixed(&f, 1234, 1, 0);      // "123.4", value already in tenths
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef FMT_H_
+#define FMT_H_
+
+#include <stdint.h>
+
+/// Most digits allowed after the decimal point
+#define FMT_MAX_DECIMALS 9
+
+/// Buffer being written, len is the current string length
+typedef struct {
+    char *buf;
+    int size;
+    int len;
+} fmt_t;
+
+/// Start writing at the beginning of buf, which holds size bytes
+void fmt_init(fmt_t *f, char *buf, int size);
+
+/// Append one character
+void fmt_char(fmt_t *f, char c);
+
+/// Append a string
+void fmt_str(fmt_t *f, const char *s);
+
+/// Append a signed integer, right-aligned in at least width characters
+void fmt_int(fmt_t *f, int32_t value, int width);
+
+/// Append an unsigned integer, right-aligned in at least width characters
+void fmt_uint(fmt_t *f, uint32_t value, int width);
+
+/// Append a fixed-point value scaled by 10^decimals, e.g. millimeters as cm
+/// with fmt_fixed(f, mm, 1, 0), right-aligned in at least width characters
+void fmt_fixed(fmt_t *f, int32_t value, int decimals, int width);
+
+/// Append a float rounded to decimals places, like "%width.decimalsf".
+/// Costs one multiply and one conversion, values too large for 32 bits
+/// after scaling are clamped.
+void fmt_float(fmt_t *f, float value, int decimals, int width);
+
+#endif /* FMT_H_ */
@@ -0,0 +1,112 @@
+/*
+ * idle.c
+ *
+ * Tickless idle with deep sleep between scheduler tasks
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stdio.h>
+#include <inc/tm4c123gh6pm.h>
+#include "idle.h"
+#include "clock.h"
+#include "Timer.h"
+#include "sched.h"
+#include "button.h"
+#include "uart.h"
+
+// Timer values at the start of the window idle_dump() reports over
+static uint64_t start_ticks;
+static uint64_t start_sleep;
+static uint64_t start_deep;
+static uint32_t start_wakeups;
+
+void idle_init(void)
+{
+    button_interruptInit();
+
+#if SYSCLK_HZ == 16000000UL
+    SYSCTL_DSLPCLKCFG_R = SYSCTL_DSLPCLKCFG_O_IOSC; // Run from the PIOSC undivided in deep sleep
+    SYSCTL_DSLPPWRCFG_R = SYSCTL_DSLPPWRCFG_FLASHPM_SLP | SYSCTL_DSLPPWRCFG_SRAMPM_SBY; // Flash off, SRAM standby
+
+    SYSCTL_DCGCWTIMER_R |= SYSCTL_DCGCWTIMER_D0; // WTIMER0 timebase and wakeup match
+    SYSCTL_DCGCTIMER_R |= SYSCTL_DCGCTIMER_D4;   // TIMER4 software timer wheel
+    SYSCTL_DCGCUART_R |= SYSCTL_DCGCUART_D1      // UART1 to PuTTY
+                       | SYSCTL_DCGCUART_D4;     // UART4 to the iRobot
+    SYSCTL_DCGCGPIO_R |= SYSCTL_DCGCGPIO_D1      // Port B, UART1 pins
+                       | SYSCTL_DCGCGPIO_D2      // Port C, UART4 pins
+                       | SYSCTL_DCGCGPIO_D4      // Port E, buttons
+                       | SYSCTL_DCGCGPIO_D5;     // Port F, OI shutoff button
+    SYSCTL_DCGCDMA_R |= SYSCTL_DCGCDMA_D0;       // uDMA, a UART1 transfer can still be running
+    SYSCTL_DCGCADC_R |= SYSCTL_DCGCADC_D0;       // ADC0, IR sensor
+    SYSCTL_DCGCWD_R |= SYSCTL_DCGCWD_D0;         // WATCHDOG0, keeps counting while asleep
+
+    // The DCGC registers only apply while SYSCTL_RCC_ACG is set,
+    // timer_sleep() sets it around each deep sleep
+    timer_allowDeepSleep(1);
+#endif
+
+    idle_resetStats();
+}
+
+void idle_waitFor(int (*ready)(void))
+{
+    uint64_t next;
+
+    while (!ready()) {
+        if (sched_runOnce()) {
+            continue;
+        }
+
+        next = sched_nextRelease();
+        if (next != UINT64_MAX) {
+            next *= CLOCK_TICKS_PER_MICRO;
+        }
+        timer_deepIdleUntil(next, ready);
+    }
+}
+
+void idle_resetStats(void)
+{
+    start_ticks = timer_getTicks();
+    start_sleep = timer_getSleepTicks();
+    start_deep = timer_getDeepSleepTicks();
+    start_wakeups = timer_getWakeups();
+}
+
+void idle_dump(void)
+{
+    char buffer[100];
+    uint64_t total = timer_getTicks() - start_ticks;
+    uint64_t deep = timer_getDeepSleepTicks() - start_deep;
+    uint64_t shallow = timer_getSleepTicks() - start_sleep - deep;
+    uint64_t run = total - shallow - deep;
+    uint32_t wakeups = timer_getWakeups() - start_wakeups;
+    uint32_t average;
+
+    if (total == 0) {
+        total = 1;
+    }
+
+    // Time weighted average of the three supply currents
+    average = (uint32_t)((run * IDLE_RUN_UA + shallow * IDLE_SLEEP_UA
+            + deep * IDLE_DEEP_SLEEP_UA) / total);
+
+    sprintf(buffer, "\r\nIdle over %lums\r\n", (unsigned long)(total / CLOCK_TICKS_PER_MILLI));
+    uart_sendStr(buffer);
+    sprintf(buffer, "Wakeups:     %lu (%lu per second)\r\n", (unsigned long)wakeups,
+            (unsigned long)((uint64_t)wakeups * SYSCLK_HZ / total));
+    uart_sendStr(buffer);
+    sprintf(buffer, "Run:         %lu.%02lu%%\r\n",
+            (unsigned long)(run * 100 / total), (unsigned long)(run * 10000 / total % 100));
+    uart_sendStr(buffer);
+    sprintf(buffer, "Sleep:       %lu.%02lu%%\r\n",
+            (unsigned long)(shallow * 100 / total), (unsigned long)(shallow * 10000 / total % 100));
+    uart_sendStr(buffer);
+    sprintf(buffer, "Deep sleep:  %lu.%02lu%%\r\n",
+            (unsigned long)(deep * 100 / total), (unsigned long)(deep * 10000 / total % 100));
+    uart_sendStr(buffer);
+    sprintf(buffer, "Est. current %luuA (busy polling would be %luuA)\r\n\r\n",
+            (unsigned long)average, (unsigned long)IDLE_RUN_UA);
+    uart_sendStr(buffer);
+}
@@ -0,0 +1,50 @@
+/*
+ * idle.h
+ *
+ * Tickless idle. idle_waitFor() runs any scheduler task that is due and
+ * otherwise puts the CPU in deep sleep until the next task release or an
+ * interrupt, such as UART1 RX or a button press, makes the wait condition
+ * true. Almost nothing ticks while idle: WTIMER0 keeps time without
+ * interrupts, the TIMER4 wheel stops whenever no software timer is armed, and
+ * WATCHDOG0 checks every WDOG_PERIOD_MS only while a supervised loop runs,
+ * every 4.5 minutes otherwise.
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef IDLE_H_
+#define IDLE_H_
+
+#include <stdint.h>
+
+// Supply current used for the estimate in idle_dump(), in microamps. Rough
+// typical figures for the TM4C123 at 16MHz with the peripherals this project
+// uses; replace them with bench measurements for a real power budget.
+#define IDLE_RUN_UA        10000 // Run mode
+#define IDLE_SLEEP_UA       5500 // Sleep mode, WFI
+#define IDLE_DEEP_SLEEP_UA  2000 // Deep sleep, PIOSC left on for the timers and UARTs
+
+/**
+ * Keep the timers, UARTs, GPIO ports, uDMA, ADC0 and WATCHDOG0 clocked in
+ * deep sleep, enable button interrupts and allow idle_waitFor() to deep
+ * sleep. Every other wait still uses WFI, so the servo, PING and anything
+ * else left out of the DCGC registers keep running. Deep sleep is only used
+ * when SYSCLK_HZ is the 16MHz PIOSC, since that is the only clock that keeps
+ * running at the same rate while asleep.
+ */
+void idle_init(void);
+
+/**
+ * Wait until ready() returns nonzero, running due scheduler tasks and
+ * sleeping in between. ready() is checked with interrupts masked right before
+ * each sleep, so a flag set by an ISR can not be missed.
+ */
+void idle_waitFor(int (*ready)(void));
+
+/// Restart the window that idle_dump() reports over
+void idle_resetStats(void);
+
+/// Send wakeups per second, time asleep and the estimated current over UART1
+void idle_dump(void);
+
+#endif /* IDLE_H_ */
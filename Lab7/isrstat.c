@@ -0,0 +1,183 @@
+/*
+ * isrstat.c
+ *
+ * Interrupt latency and duration histograms using the DWT cycle counter
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stdio.h>
+#include "isrstat.h"
+#include "uart.h"
+#include "Timer.h"
+
+// Core debug registers, not part of tm4c123gh6pm.h
+#define CORE_DEMCR_R    (*((volatile uint32_t *)0xE000EDFC)) // Debug Exception and Monitor Control
+#define DWT_CTRL_R      (*((volatile uint32_t *)0xE0001000)) // DWT Control
+#define DWT_CYCCNT_R    (*((volatile uint32_t *)0xE0001004)) // DWT Cycle Count
+
+#define CORE_DEMCR_TRCENA   0x01000000 // Enables the DWT unit
+#define DWT_CTRL_CYCCNTENA  0x00000001 // Enables CYCCNT
+
+static isrstat_stats_t vectors[ISRSTAT_NUM_VECTORS];
+static uint64_t window_start; // Timebase ticks at the last reset, CYCCNT wraps too often to use here
+
+// Names printed by isrstat_dump(), in the same order as isrstat_vector_t
+static const char *vector_names[ISRSTAT_NUM_VECTORS] = {
+    "UART1",
+    "TIMER3B",
+    "GPIOF",
+    "TIMER4A wheel",
+    "WTIMER0A match",
+    "UART4 OI",
+};
+
+/**
+ * Find the histogram bucket for a number of cycles
+ */
+static int isrstat_bucket(uint32_t cycles)
+{
+    int bucket = 0;
+
+    cycles >>= ISRSTAT_BUCKET_SHIFT;
+    while (cycles && bucket < ISRSTAT_BUCKETS - 1) {
+        cycles >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+void isrstat_init(void)
+{
+    CORE_DEMCR_R |= CORE_DEMCR_TRCENA;  // Turn on the DWT unit
+    DWT_CTRL_R |= DWT_CTRL_CYCCNTENA;   // Start counting cycles
+
+    isrstat_reset();
+}
+
+void isrstat_reset(void)
+{
+    int i, j;
+    for (i = 0; i < ISRSTAT_NUM_VECTORS; i++) {
+        vectors[i].count = 0;
+        vectors[i].latency_count = 0;
+        vectors[i].latency_max = 0;
+        vectors[i].duration_max = 0;
+        vectors[i].duration_total = 0;
+        for (j = 0; j < ISRSTAT_BUCKETS; j++) {
+            vectors[i].latency[j] = 0;
+            vectors[i].duration[j] = 0;
+        }
+    }
+
+    window_start = timer_getTicks();
+}
+
+uint32_t isrstat_enter(isrstat_vector_t vector, uint32_t latency)
+{
+    uint32_t entry = DWT_CYCCNT_R;
+    isrstat_stats_t *v = &vectors[vector];
+
+    if (latency != ISRSTAT_NO_LATENCY) {
+        v->latency_count++;
+        v->latency[isrstat_bucket(latency)]++;
+        if (latency > v->latency_max) {
+            v->latency_max = latency;
+        }
+    }
+
+    return entry;
+}
+
+void isrstat_exit(isrstat_vector_t vector, uint32_t entry)
+{
+    // Unsigned subtraction handles CYCCNT wrapping once between enter and exit
+    uint32_t cycles = DWT_CYCCNT_R - entry;
+    isrstat_stats_t *v = &vectors[vector];
+
+    v->count++;
+    v->duration_total += cycles;
+    v->duration[isrstat_bucket(cycles)]++;
+    if (cycles > v->duration_max) {
+        v->duration_max = cycles;
+    }
+}
+
+const isrstat_stats_t *isrstat_getStats(isrstat_vector_t vector)
+{
+    return &vectors[vector];
+}
+
+/**
+ * Send one histogram row over UART1
+ */
+static void isrstat_sendHistogram(const char *label, const uint32_t *hist)
+{
+    char buffer[24];
+    int i;
+
+    uart_sendStr(label);
+    for (i = 0; i < ISRSTAT_BUCKETS; i++) {
+        sprintf(buffer, " %6lu", (unsigned long)hist[i]);
+        uart_sendStr(buffer);
+    }
+    uart_sendStr("\r\n");
+}
+
+void isrstat_dump(void)
+{
+    isrstat_stats_t snapshot[ISRSTAT_NUM_VECTORS];
+    uint64_t window;
+    char buffer[100];
+    int i;
+
+    // Copy first so the handlers being measured don't change values mid-print
+    for (i = 0; i < ISRSTAT_NUM_VECTORS; i++) {
+        snapshot[i] = vectors[i];
+    }
+    window = timer_getTicks() - window_start;
+    if (window == 0) {
+        window = 1;
+    }
+
+    uart_sendStr("\r\nVector            Count  MaxLat  MaxDur  AvgDur  CPU(0.01%)\r\n");
+    uart_sendStr("------------------------------------------------------------\r\n");
+
+    for (i = 0; i < ISRSTAT_NUM_VECTORS; i++) {
+        isrstat_stats_t *v = &snapshot[i];
+        uint32_t avg = v->count ? (uint32_t)(v->duration_total / v->count) : 0;
+        uint32_t share = (uint32_t)(v->duration_total * 10000 / window);
+
+        sprintf(buffer, "%-15s %7lu  %6lu  %6lu  %6lu  %10lu\r\n",
+                vector_names[i],
+                (unsigned long)v->count,
+                (unsigned long)v->latency_max,
+                (unsigned long)v->duration_max,
+                (unsigned long)avg,
+                (unsigned long)share);
+        uart_sendStr(buffer);
+    }
+
+    // Bucket headers are the exclusive upper bound in cycles, the last is open ended
+    uart_sendStr("\r\nCycles below   ");
+    for (i = 0; i < ISRSTAT_BUCKETS - 1; i++) {
+        sprintf(buffer, " %6lu", 1UL << (i + ISRSTAT_BUCKET_SHIFT));
+        uart_sendStr(buffer);
+    }
+    uart_sendStr("   more\r\n");
+
+    for (i = 0; i < ISRSTAT_NUM_VECTORS; i++) {
+        if (snapshot[i].count == 0) {
+            continue;
+        }
+        sprintf(buffer, "%-15s\r\n", vector_names[i]);
+        uart_sendStr(buffer);
+        if (snapshot[i].latency_count) {
+            isrstat_sendHistogram("  latency      ", snapshot[i].latency);
+        }
+        isrstat_sendHistogram("  duration     ", snapshot[i].duration);
+    }
+
+    uart_sendStr("\r\n");
+}
@@ -0,0 +1,74 @@
+/*
+ * isrstat.h
+ *
+ * Interrupt latency and duration histograms. Instrumented handlers call
+ * isrstat_enter() first and isrstat_exit() last; isrstat_dump() prints a
+ * per-vector table over UART1. Times are CPU clock cycles from the DWT cycle
+ * counter.
+ *
+ * Latency is the time from the hardware event to the first instruction of the
+ * handler, and is only recorded for vectors whose peripheral timestamps the
+ * event. Duration includes any time spent in higher priority handlers that
+ * preempted this one.
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef ISRSTAT_H_
+#define ISRSTAT_H_
+
+#include <stdint.h>
+
+/// Instrumented vectors, add new vectors before ISRSTAT_NUM_VECTORS and name them in isrstat.c
+typedef enum {
+    ISRSTAT_UART1,
+    ISRSTAT_TIMER3B,
+    ISRSTAT_GPIOF,
+    ISRSTAT_TIMER_WHEEL,
+    ISRSTAT_TIMER_MATCH,
+    ISRSTAT_UART4,
+    ISRSTAT_NUM_VECTORS
+} isrstat_vector_t;
+
+/// Passed to isrstat_enter() by handlers that cannot tell when their event happened
+#define ISRSTAT_NO_LATENCY 0xFFFFFFFF
+
+/// Histogram bucket i counts times below 2^(i + ISRSTAT_BUCKET_SHIFT) cycles, the last bucket counts everything above
+#define ISRSTAT_BUCKETS      12
+#define ISRSTAT_BUCKET_SHIFT 5
+
+/// Statistics kept for each vector, all in CPU clock cycles
+typedef struct {
+    uint32_t count;                      // Number of completed enter/exit pairs
+    uint32_t latency_count;              // Number of entries with a known latency
+    uint32_t latency_max;                // Longest latency
+    uint32_t duration_max;               // Longest run
+    uint64_t duration_total;             // Sum of all runs
+    uint32_t latency[ISRSTAT_BUCKETS];   // Latency histogram
+    uint32_t duration[ISRSTAT_BUCKETS];  // Duration histogram
+} isrstat_stats_t;
+
+/// Enable the DWT cycle counter and clear all vector statistics
+void isrstat_init(void);
+
+/// Clear all vector statistics and restart the window the CPU share is measured over
+void isrstat_reset(void);
+
+/**
+ * Mark the entry of a handler.
+ * @param vector Vector being handled
+ * @param latency Cycles between the event and handler entry, or ISRSTAT_NO_LATENCY
+ * @return entry timestamp to pass to isrstat_exit()
+ */
+uint32_t isrstat_enter(isrstat_vector_t vector, uint32_t latency);
+
+/// Mark the exit of a handler and record the cycles since isrstat_enter()
+void isrstat_exit(isrstat_vector_t vector, uint32_t entry);
+
+/// Get the statistics recorded for one vector
+const isrstat_stats_t *isrstat_getStats(isrstat_vector_t vector);
+
+/// Send the statistics and histograms for every vector over UART1
+void isrstat_dump(void);
+
+#endif /* ISRSTAT_H_ */
@@ -8,6 +8,7 @@
  * @date March 25, 2025
  */
 
+#include "clock.h"
 #include "Timer.h"
 #include "lcd.h"
 #include <string.h>
@@ -16,12 +17,25 @@
 #include "cyBot_Scan.h"
 #include "open_interface.h"
 #include "movement.h"
-
-// Constants for scanning
+#include "profile.h"
+#include "sched.h"
+#include "isrstat.h"
+#include "wdog.h"
+#include "idle.h"
+#include "button.h"
+#include "telemetry.h"
+#include "fmt.h"
+#include "log.h"
+#include "cmd.h"
+#include "chan.h"
+
+// Constants for scanning, defaults for the scan_min, scan_max and step parameters
 #define MIN_ANGLE 0
 #define MAX_ANGLE 180
 #define STEP 2     // Scan every 1 degree for better precision
 #define NUM_POINTS (((MAX_ANGLE - MIN_ANGLE) / STEP) + 1)
+#define MAX_POINTS (MAX_ANGLE - MIN_ANGLE + 1) // Points in a scan at a step of 1 degree
+#define SCAN_WDOG_TIMEOUT_MS 2000 // Longest one scan point can take, covers the servo sweeping back from 180
 
 // Thresholds for edge detection
 #define IR_THRESHOLD 150          // Threshold for IR value differences
@@ -33,13 +47,41 @@
 #define LEFT_CAL 1188250
 #define RIGHT_CAL 238000
 
-// Arrays for storing data
-float angles[NUM_POINTS];
-float ping_values[NUM_POINTS];
-float ping_filtered[NUM_POINTS];
-int ir_values[NUM_POINTS];
-int ir_filtered[NUM_POINTS];
-int ir_diff[NUM_POINTS];          // Differences between consecutive IR values
+// IR values above this are considered objects
+#define IR_OBJECT_THRESHOLD 950
+
+// Time the host gets to confirm a new baud rate before the old one comes back
+#define BAUD_CONFIRM_MS 2000
+
+// Period of the task that shows the pose at the prompt
+#define UI_TASK_MS 200
+
+// Tunable from the console with "set", start at the defaults above
+int32_t scan_min = MIN_ANGLE;
+int32_t scan_max = MAX_ANGLE;
+int32_t scan_step = STEP;
+int32_t ir_object_threshold = IR_OBJECT_THRESHOLD;
+int32_t min_object_width = (int32_t)MIN_OBJECT_WIDTH;
+int32_t left_cal = LEFT_CAL;
+int32_t right_cal = RIGHT_CAL;
+
+// Build the 'f' command, which times sprintf against fmt for every scan line.
+// Its %f needs --printf_support=full, the project links the nofloat printf.
+#define FORMAT_BENCHMARK 0
+
+// Formatted scan table for benchmark_scan_dump(), about 40 bytes per point.
+// Sized for the default step, finer scans are cut short.
+#define SCAN_DUMP_SIZE (NUM_POINTS * 40 + 128)
+char scan_dump[SCAN_DUMP_SIZE];
+
+// Arrays for storing data, the first num_points entries are the last scan
+float angles[MAX_POINTS];
+float ping_values[MAX_POINTS];
+float ping_filtered[MAX_POINTS];
+int ir_values[MAX_POINTS];
+int ir_filtered[MAX_POINTS];
+int ir_diff[MAX_POINTS];          // Differences between consecutive IR values
+int num_points = NUM_POINTS;
 
 // Object information structure
 typedef struct {
@@ -67,12 +109,82 @@ float calculate_linear_width(float radialWidth, float distance);
 void send_uart_string(const char *str);
 void clear_terminal(void);
 void navigate_to_smallest_object(oi_t *sensor_data);
+int input_ready(void);
+void task_ui(void *arg);
+void benchmark_scan_dump(void);
+void benchmark_format(void);
+int format_scan_line(char *line, int size, int angle, float ping, int ir);
+void send_value(const char *label, float value, const char *suffix);
+
+// Console commands, see cmd.h
+static int cmd_mission(int argc, char *argv[]);
+static int cmd_scan(int argc, char *argv[]);
+static int cmd_profile(int argc, char *argv[]);
+static int cmd_tasks(int argc, char *argv[]);
+static int cmd_interrupts(int argc, char *argv[]);
+static int cmd_watchdog(int argc, char *argv[]);
+static int cmd_energy(int argc, char *argv[]);
+static int cmd_pose(int argc, char *argv[]);
+static int cmd_uart(int argc, char *argv[]);
+static int cmd_dump(int argc, char *argv[]);
+static int cmd_binary(int argc, char *argv[]);
+static int cmd_baud(int argc, char *argv[]);
+#if FORMAT_BENCHMARK
+static int cmd_format(int argc, char *argv[]);
+#endif
+#if OI_ODOMETRY_BENCHMARK
+static int cmd_odometry(int argc, char *argv[]);
+#endif
+static int cmd_quit(int argc, char *argv[]);
+
+static const cmd_t commands[] = {
+    { "m",    "",                  "Start scan and navigation",                   cmd_mission },
+    { "scan", "[min max step]",    "Scan and detect objects without driving",     cmd_scan },
+    { "p",    "",                  "Print profiling statistics",                  cmd_profile },
+    { "t",    "",                  "Print task statistics",                       cmd_tasks },
+    { "i",    "",                  "Print interrupt statistics",                  cmd_interrupts },
+    { "w",    "",                  "Print watchdog statistics",                   cmd_watchdog },
+    { "e",    "",                  "Print idle wakeups and estimated current",    cmd_energy },
+    { "pose", "",                  "Print the latest sensor snapshot's pose and the OI stream counters", cmd_pose },
+    { "u",    "",                  "Print UART, channel and log buffer statistics", cmd_uart },
+    { "d",    "",                  "Dump the last scan through the TX buffer and the uDMA", cmd_dump },
+    { "b",    "",                  "Toggle binary telemetry for scans, objects and odometry", cmd_binary },
+    { "baud", "[rate]",            "Switch UART1 baud rate, or list rates and their error", cmd_baud },
+#if FORMAT_BENCHMARK
+    { "f",    "",                  "Time sprintf against fmt formatting the last scan", cmd_format },
+#endif
+#if OI_ODOMETRY_BENCHMARK
+    { "o",    "[updates]",         "Time the float odometry against the old double version", cmd_odometry },
+#endif
+    { "q",    "",                  "Quit",                                        cmd_quit },
+};
+
+static const cmd_param_t params[] = {
+    { "scan_min",  &scan_min,            MIN_ANGLE, MAX_ANGLE, "First scan angle, degrees" },
+    { "scan_max",  &scan_max,            MIN_ANGLE, MAX_ANGLE, "Last scan angle, degrees" },
+    { "step",      &scan_step,           1, MAX_ANGLE,         "Degrees between scan points" },
+    { "ir_thresh", &ir_object_threshold, 0, 4095,              "IR raw value above which a point is an object" },
+    { "min_width", &min_object_width,    0, MAX_ANGLE,         "Narrowest object kept, degrees" },
+    { "left_cal",  &left_cal,            0, 2000000,           "Servo calibration at 180 degrees" },
+    { "right_cal", &right_cal,           0, 2000000,           "Servo calibration at 0 degrees" },
+};
+
+#define NUM_COMMANDS ((int)(sizeof(commands) / sizeof(commands[0])))
+#define NUM_PARAMS ((int)(sizeof(params) / sizeof(params[0])))
+
+static oi_t *robot;   // Sensor data the commands drive with
+static int running = 1;
 
 int main(void)
 {
+    // Set up the system clock before any peripheral
+    clock_init();
+
     // Initialize robot
     oi_t *sensor_data = oi_alloc();
     oi_init(sensor_data);
+    movement_init(); // Only fetch the sensors the movement loops use
+    robot = sensor_data;
 
     // Initialize hardware
     timer_init();
@@ -81,49 +193,328 @@ int main(void)
     // Initialize UART
     uart_interrupt_init();
 
+    // Command replies ahead of console text ahead of telemetry
+    chan_init();
+
+    // Start the cycle counter used by the profiling zones
+    profile_init();
+    isrstat_init();
+
+    // Stop the wheels if a movement or scan loop hangs
+    wdog_init();
+
+    // Deep sleep at the prompt, waking on UART1, a button or the next task
+    idle_init();
+
     // Initialize CyBot scan with proper calibration values
     cyBOT_init_Scan(0b0111);  // Enable servo, PING, and IR
-    right_calibration_value = RIGHT_CAL;
-    left_calibration_value = LEFT_CAL;
+    right_calibration_value = right_cal;
+    left_calibration_value = left_cal;
 
     // Position servo at 0 degrees to start
     cyBOT_Scan_t scan;
     cyBOT_Scan(0, &scan);
     timer_waitMillis(500);
 
+    // Periodic tasks, idle_waitFor() runs them between commands. They run
+    // while the prompt sleeps, so they must not touch the servo, the sensors
+    // or the iRobot.
+    sched_init();
+    sched_addTask("ui", task_ui, NULL, UI_TASK_MS, 0);
+
     // Display welcome message
     clear_terminal();
     send_uart_string("=== Lab 7: Drive to Smallest Width Object ===\r\n\r\n");
-    send_uart_string("Commands:\r\n");
-    send_uart_string("  m - Start scan and navigation\r\n");
-    send_uart_string("  q - Quit\r\n\r\n");
+    cmd_init(commands, NUM_COMMANDS, params, NUM_PARAMS);
+    cmd_printHelp();
+    send_uart_string("  Button 1 - Same as m\r\n\r\n");
 
-    while (1)
+    while (running)
     {
-        // Wait for user command
-        char cmd = uart_receive();
+        // Send the log records from the last command, then sleep until a
+        // byte arrives over UART1, a button is pressed or something logs.
+        // Commands are whole lines, cmd_poll() returns right away until the
+        // line is complete.
+        log_flush();
+        idle_waitFor(input_ready);
+        if (!cmd_poll() && (button_getEvent() & 0x01)) {
+            cmd_mission(0, NULL);
+        }
+    }
 
-        if (cmd == 'q') {
-            // Quit program
-            send_uart_string("\r\nExiting program.\r\n");
-            break;
+    // Clean up
+    chan_flush();
+    oi_free(sensor_data);
+    return 0;
+}
+
+// Start mission
+static int cmd_mission(int argc, char *argv[])
+{
+    clear_terminal();
+    send_uart_string("Starting mission: Drive to smallest width object\r\n\r\n");
+
+    // Navigate to the smallest object
+    navigate_to_smallest_object(robot);
+
+    send_uart_string("\r\nType m to scan again or q to quit.\r\n");
+    return CMD_OK;
+}
+
+// Scan and detect objects in place, optionally setting the scan range first
+static int cmd_scan(int argc, char *argv[])
+{
+    int32_t min, max, step;
+
+    if (argc != 1 && argc != 4) {
+        return CMD_USAGE;
+    }
+    if (argc == 4) {
+        if (cmd_parseInt(argv[1], &min) || cmd_parseInt(argv[2], &max) || cmd_parseInt(argv[3], &step) ||
+            min < MIN_ANGLE || max > MAX_ANGLE || min > max || step < 1) {
+            return CMD_USAGE;
         }
-        else if (cmd == 'm')
-        {
-            // Start mission
-            clear_terminal();
-            send_uart_string("Starting mission: Drive to smallest width object\r\n\r\n");
+        scan_min = min;
+        scan_max = max;
+        scan_step = step;
+    }
+
+    get_angle_array();
+    scan_all_angles();
+    filter_sensor_data();
+    compute_ir_diff();
+    detect_objects();
+    return CMD_OK;
+}
+
+// Dump cycle counts for every profiled zone
+static int cmd_profile(int argc, char *argv[])
+{
+    profile_dump();
+    return CMD_OK;
+}
+
+// Dump deadline misses and execution times for every task
+static int cmd_tasks(int argc, char *argv[])
+{
+    sched_dump();
+    return CMD_OK;
+}
+
+// Dump interrupt latency and duration histograms
+static int cmd_interrupts(int argc, char *argv[])
+{
+    isrstat_dump();
+    return CMD_OK;
+}
+
+// Dump deadline misses for every supervised loop
+static int cmd_watchdog(int argc, char *argv[])
+{
+    wdog_dump();
+    return CMD_OK;
+}
+
+// Dump wakeups per second and estimated current since the last 'e'
+static int cmd_energy(int argc, char *argv[])
+{
+    idle_dump();
+    idle_resetStats();
+    return CMD_OK;
+}
 
-            // Navigate to the smallest object
-            navigate_to_smallest_object(sensor_data);
+// Print the pose from the latest sensor snapshot, without asking the Create
+// for new data, and the OI stream counters
+static int cmd_pose(int argc, char *argv[])
+{
+    oi_snapshot_t snapshot;
+    oi_stream_stats_t stream;
+    char buffer[100];
+
+    if (oi_get_snapshot(&snapshot) == 0) {
+        send_uart_string("\r\nNo sensor data yet\r\n");
+        return CMD_OK;
+    }
+    sprintf(buffer, "\r\nSnapshot %lu, %lu ms old\r\n", (unsigned long)snapshot.seq,
+            (unsigned long)(timer_getMillis() - snapshot.time_ms));
+    send_uart_string(buffer);
+    send_value("x ", snapshot.sensors.x / 10.0f, " cm\r\n");
+    send_value("y ", snapshot.sensors.y / 10.0f, " cm\r\n");
+    send_value("Heading ", snapshot.sensors.heading, " deg\r\n");
+    send_value("Odometer ", snapshot.sensors.odometer / 10.0f, " cm\r\n");
+
+    oi_getStreamStats(&stream);
+    sprintf(buffer, "Stream packets %lu, bad %lu, byte errors %lu, timeouts %lu\r\n",
+            (unsigned long)stream.packets, (unsigned long)stream.bad,
+            (unsigned long)stream.errors, (unsigned long)stream.timeouts);
+    send_uart_string(buffer);
+    return CMD_OK;
+}
+
+// Dump UART1 transmit and receive buffer counters
+static int cmd_uart(int argc, char *argv[])
+{
+    uart_tx_stats_t tx;
+    uart_rx_stats_t rx;
+    log_stats_t log;
+    char buffer[100];
+    uart_getTxStats(&tx);
+    uart_getRxStats(&rx);
+    log_getStats(&log);
+    sprintf(buffer, "\r\nTX queued %lu, dropped %lu, peak %lu of %d bytes\r\n",
+            (unsigned long)tx.queued, (unsigned long)tx.dropped,
+            (unsigned long)tx.peak, UART_TX_BUFFER_SIZE);
+    send_uart_string(buffer);
+    sprintf(buffer, "RX received %lu, overruns %lu, FIFO overruns %lu, errors %lu\r\n",
+            (unsigned long)rx.received, (unsigned long)rx.overruns,
+            (unsigned long)rx.hw_overruns, (unsigned long)rx.errors);
+    send_uart_string(buffer);
+    sprintf(buffer, "Log records %lu, dropped %lu, peak %lu of %d bytes\r\n",
+            (unsigned long)log.records, (unsigned long)log.dropped,
+            (unsigned long)log.peak, LOG_BUFFER_SIZE);
+    send_uart_string(buffer);
+    chan_dump();
+    return CMD_OK;
+}
+
+// Time the last scan table going out both ways
+static int cmd_dump(int argc, char *argv[])
+{
+    benchmark_scan_dump();
+    return CMD_OK;
+}
+
+// Switch scan, object and odometry output between text and binary frames
+static int cmd_binary(int argc, char *argv[])
+{
+    char buffer[100];
+    if (telemetry_enabled()) {
+        telemetry_stats_t stats;
+        telemetry_enable(0);
+        telemetry_getStats(&stats);
+        sprintf(buffer, "\r\nBinary telemetry off, %lu frames, %lu bytes, %lu scan samples, %lu dropped\r\n",
+                (unsigned long)stats.frames, (unsigned long)stats.bytes,
+                (unsigned long)stats.samples, (unsigned long)stats.dropped);
+        send_uart_string(buffer);
+    }
+    else {
+        send_uart_string("\r\nBinary telemetry on, decode with tools/telemetry_decode.py\r\n");
+        telemetry_resetOdometry();
+        telemetry_enable(1);
+    }
+    return CMD_OK;
+}
+
+// Format a baud rate and its divisor error as one line, e.g. "BAUD 921600 +0.64%"
+static void format_baud(char *buffer, int size, const char *prefix, uint32_t baud)
+{
+    int32_t error = uart_baudError(baud);
+    fmt_t f;
+    fmt_init(&f, buffer, size);
+    fmt_str(&f, prefix);
+    fmt_uint(&f, baud, 0);
+    fmt_char(&f, ' ');
+    if (error == INT32_MAX) {
+        fmt_str(&f, "unreachable");
+    }
+    else {
+        fmt_char(&f, error < 0 ? '-' : '+');
+        fmt_fixed(&f, error < 0 ? -error : error, 2, 0);
+        fmt_char(&f, '%');
+    }
+    fmt_str(&f, "\r\n");
+}
+
+// Switch UART1 to a new rate. The reply goes out at the old rate, then the
+// host has BAUD_CONFIRM_MS to send "ok" on its own line at the new rate or
+// the old rate comes back. tools/uart_baud.py is the host side.
+static int cmd_baud(int argc, char *argv[])
+{
+    static const uint32_t rates[] = { 115200, 230400, 460800, 921600 };
+    uint32_t old_baud = uart_getBaud();
+    uint64_t deadline;
+    char buffer[64];
+    char line[UART_LINE_SIZE];
+    int32_t baud, error;
+    int i;
 
-            send_uart_string("\r\nPress 'm' to scan again or 'q' to quit.\r\n");
+    if (argc == 1) {
+        format_baud(buffer, sizeof(buffer), "Now ", old_baud);
+        cmd_reply(buffer);
+        for (i = 0; i < (int)(sizeof(rates) / sizeof(rates[0])); i++) {
+            format_baud(buffer, sizeof(buffer), "  ", rates[i]);
+            cmd_reply(buffer);
         }
+        return CMD_OK;
+    }
+    if (argc != 2 || cmd_parseInt(argv[1], &baud) != 0 || baud <= 0) {
+        return CMD_USAGE;
     }
 
-    // Clean up
-    oi_free(sensor_data);
-    return 0;
+    error = uart_baudError(baud);
+    if (error > UART_BAUD_MAX_ERROR || error < -UART_BAUD_MAX_ERROR) {
+        format_baud(buffer, sizeof(buffer), "BAUD FAIL ", baud);
+        cmd_reply(buffer);
+        return CMD_OK;
+    }
+    format_baud(buffer, sizeof(buffer), "BAUD ", baud);
+    cmd_reply(buffer);
+    chan_flush();
+    uart_setBaud(baud);
+
+    // Wait for the host's "ok", the line it sends first flushes anything
+    // garbled while the rates didn't match. Sleeps until each byte arrives.
+    uart_setEcho(0);
+    deadline = timer_getTicks() + (uint64_t)BAUD_CONFIRM_MS * CLOCK_TICKS_PER_MILLI;
+    do {
+        if (uart_getLine(line, sizeof(line)) >= 0 && strcmp(line, "ok") == 0) {
+            uart_setEcho(1);
+            cmd_reply("BAUD OK\r\n");
+            return CMD_OK;
+        }
+    } while (timer_idleUntil(deadline, uart_rxReady));
+    uart_setBaud(old_baud);
+    uart_setEcho(1);
+    cmd_reply("BAUD REVERTED\r\n");
+    return CMD_OK;
+}
+
+#if FORMAT_BENCHMARK
+// Format the last scan both ways and dump the profile zones
+static int cmd_format(int argc, char *argv[])
+{
+    benchmark_format();
+    return CMD_OK;
+}
+#endif
+
+#if OI_ODOMETRY_BENCHMARK
+// Run a made-up drive through both odometry versions, print how far apart
+// they ended up and the profile zones
+static int cmd_odometry(int argc, char *argv[])
+{
+    int32_t updates = 4000;
+    float max_position, max_heading;
+
+    if (argc > 2 || (argc == 2 && (cmd_parseInt(argv[1], &updates) != 0 || updates < 1))) {
+        return CMD_USAGE;
+    }
+
+    profile_reset();
+    oi_benchmarkOdometry(updates, &max_position, &max_heading);
+    send_value("\r\nLargest position difference ", max_position * 1000.0f, " um\r\n");
+    send_value("Largest heading difference ", max_heading * 1000.0f, " millidegrees\r\n");
+    profile_dump();
+    return CMD_OK;
+}
+#endif
+
+// Quit program
+static int cmd_quit(int argc, char *argv[])
+{
+    send_uart_string("\r\nExiting program.\r\n");
+    running = 0;
+    return CMD_OK;
 }
 
 /**
@@ -189,14 +580,9 @@ void navigate_to_smallest_object(oi_t *sensor_data)
         sprintf(buffer, "Found smallest object (Object %d):\r\n", smallestIndex + 1);
         send_uart_string(buffer);
 
-        sprintf(buffer, "  - Center angle: %.1f degrees\r\n", targetAngle);
-        send_uart_string(buffer);
-
-        sprintf(buffer, "  - Distance: %.1f cm\r\n", targetDistance);
-        send_uart_string(buffer);
-
-        sprintf(buffer, "  - Linear width: %.1f cm\r\n\r\n", objects[smallestIndex].linearWidth);
-        send_uart_string(buffer);
+        send_value("  - Center angle: ", targetAngle, " degrees\r\n");
+        send_value("  - Distance: ", targetDistance, " cm\r\n");
+        send_value("  - Linear width: ", objects[smallestIndex].linearWidth, " cm\r\n\r\n");
 
         send_uart_string("Navigating to smallest object...\r\n");
 
@@ -231,14 +617,9 @@ void navigate_to_smallest_object(oi_t *sensor_data)
                 sprintf(buffer, "Found target again (Object %d):\r\n", smallestIndex + 1);
                 send_uart_string(buffer);
 
-                sprintf(buffer, "  - Center angle: %.1f degrees\r\n", objects[smallestIndex].centerAngle);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Distance: %.1f cm\r\n", objects[smallestIndex].distance);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Linear width: %.1f cm\r\n\r\n", objects[smallestIndex].linearWidth);
-                send_uart_string(buffer);
+                send_value("  - Center angle: ", objects[smallestIndex].centerAngle, " degrees\r\n");
+                send_value("  - Distance: ", objects[smallestIndex].distance, " cm\r\n");
+                send_value("  - Linear width: ", objects[smallestIndex].linearWidth, " cm\r\n\r\n");
 
                 // Go to the object without allowing another rescan
                 go_to_position(sensor_data, objects[smallestIndex].centerAngle, objects[smallestIndex].distance);
@@ -254,51 +635,65 @@ void navigate_to_smallest_object(oi_t *sensor_data)
 
 }
 
-// Populate the angles[] array from MIN_ANGLE to MAX_ANGLE in STEP increments
+// Populate the angles[] array from scan_min to scan_max in scan_step increments
 void get_angle_array(void)
 {
-    float angleVal = MIN_ANGLE;
+    float angleVal = scan_min;
     int i;
-    for (i = 0; i < NUM_POINTS; i++) {
+    num_points = scan_max >= scan_min ? (scan_max - scan_min) / scan_step + 1 : 1;
+    for (i = 0; i < num_points; i++) {
         angles[i] = angleVal;
-        angleVal += STEP;
+        angleVal += scan_step;
     }
 }
 
 // Perform a full scan and collect PING and IR data at each angle
 void scan_all_angles(void)
 {
-    right_calibration_value = RIGHT_CAL;
-    left_calibration_value = LEFT_CAL;
+    right_calibration_value = right_cal;
+    left_calibration_value = left_cal;
     cyBOT_Scan_t scan;
     char buffer[100];
 
+    profile_begin(PROFILE_SCAN_ALL_ANGLES);
+
     send_uart_string("Scanning...\r\n");
-    send_uart_string("Angle   PING Distance (cm)   IR Value\r\n");
-    send_uart_string("----------------------------------------\r\n");
+    if (!telemetry_enabled()) {
+        send_uart_string("Angle   PING Distance (cm)   IR Value\r\n");
+        send_uart_string("----------------------------------------\r\n");
+    }
 
-    // Perform scan from MIN_ANGLE to MAX_ANGLE in STEP increments
+    // Perform scan from scan_min to scan_max in scan_step increments
     int i;
-    for (i = 0; i < NUM_POINTS; i++) {
+    wdog_begin(WDOG_SCAN, SCAN_WDOG_TIMEOUT_MS);
+    for (i = 0; i < num_points; i++) {
         int angle = (int)angles[i];
 
         // Get sensor readings at this angle
         cyBOT_Scan(angle, &scan);
+        if (wdog_feed()) {
+            break; // Scan hung, keep whatever points were read
+        }
 
         // Store the values
         ping_values[i] = scan.sound_dist;
         ir_values[i] = scan.IR_raw_val;
 
-        // Display data for every angle
-        sprintf(buffer, "%3d        %6.1f                %4d\r\n",
-                angle, ping_values[i], ir_values[i]);
-        send_uart_string(buffer);
-
-        // Small delay to prevent UART buffer overrun
-        timer_waitMillis(2);
+        // Send data for every angle, packed into binary frames if telemetry is on
+        if (telemetry_enabled()) {
+            telemetry_scanSample(angle, ir_values[i], ping_values[i]);
+        }
+        else {
+            format_scan_line(buffer, sizeof(buffer), angle, ping_values[i], ir_values[i]);
+            send_uart_string(buffer);
+        }
     }
+    wdog_end();
+    telemetry_scanFlush();
 
     send_uart_string("\r\n");
+
+    profile_end(PROFILE_SCAN_ALL_ANGLES);
 }
 
 // Apply median filters to both PING and IR data to reduce noise
@@ -308,14 +703,14 @@ void filter_sensor_data(void)
 
     // Copy boundaries directly (no filtering for first and last points)
     ping_filtered[0] = ping_values[0];
-    ping_filtered[NUM_POINTS - 1] = ping_values[NUM_POINTS - 1];
+    ping_filtered[num_points - 1] = ping_values[num_points - 1];
 
     ir_filtered[0] = ir_values[0];
-    ir_filtered[NUM_POINTS - 1] = ir_values[NUM_POINTS - 1];
+    ir_filtered[num_points - 1] = ir_values[num_points - 1];
 
     // Apply median filter of 3 to interior points
     int i;
-    for (i = 1; i < NUM_POINTS - 1; i++) {
+    for (i = 1; i < num_points - 1; i++) {
         // PING filter (float values)
         ping_filtered[i] = median_of_3_float(
             ping_values[i - 1],
@@ -369,7 +764,7 @@ void compute_ir_diff(void)
 {
     ir_diff[0] = 0;  // First element has no difference
     int i;
-    for (i = 1; i < NUM_POINTS; i++) {
+    for (i = 1; i < num_points; i++) {
         ir_diff[i] = ir_filtered[i] - ir_filtered[i - 1];
     }
 }
@@ -377,12 +772,11 @@ void compute_ir_diff(void)
 // Detect objects using IR for edge detection and PING for distance
 void detect_objects(void)
 {
+    profile_begin(PROFILE_DETECT_OBJECTS);
+
     send_uart_string("Detecting objects...\r\n\r\n");
     objectCount = 0;
 
-    // IR detection thresholds - adjusted based on your scan data
-    #define IR_OBJECT_THRESHOLD 950   // IR values above this are considered objects
-
     // Track object detection state
     int onObject = 0;
     int startIndex = 0;
@@ -391,24 +785,22 @@ void detect_objects(void)
     int j;
 
     // Find objects using absolute IR values
-    for (i = 1; i < NUM_POINTS - 1; i++) {
+    for (i = 1; i < num_points - 1; i++) {
         // Start of object: IR value exceeds threshold
-        if (!onObject && ir_filtered[i] > IR_OBJECT_THRESHOLD) {
+        if (!onObject && ir_filtered[i] > ir_object_threshold) {
             startIndex = i;
             onObject = 1;
 
-            sprintf(buffer, "Leading edge detected at angle %.1f (IR value: %d)\r\n",
-                    angles[i], ir_filtered[i]);
-            send_uart_string(buffer);
+            LOG_DEBUG("Leading edge detected at angle %.1f (IR value: %d)",
+                      log_float(angles[i]), ir_filtered[i]);
         }
         // End of object: IR value drops below threshold
-        else if (onObject && ir_filtered[i] < IR_OBJECT_THRESHOLD) {
+        else if (onObject && ir_filtered[i] < ir_object_threshold) {
             int endIndex = i - 1;
             onObject = 0;
 
-            sprintf(buffer, "Trailing edge detected at angle %.1f (IR value: %d)\r\n",
-                    angles[endIndex], ir_filtered[endIndex]);
-            send_uart_string(buffer);
+            LOG_DEBUG("Trailing edge detected at angle %.1f (IR value: %d)",
+                      log_float(angles[endIndex]), ir_filtered[endIndex]);
 
             // Calculate object properties
             float startAngle = angles[startIndex];
@@ -417,8 +809,8 @@ void detect_objects(void)
             float centerAngle = (startAngle + endAngle) / 2.0f;
 
             // Skip objects that are too narrow (likely noise)
-            if (radialWidth < MIN_OBJECT_WIDTH) {
-                send_uart_string("Object too narrow, skipping...\r\n");
+            if (radialWidth < min_object_width) {
+                LOG_DEBUG("Object too narrow, skipping...");
                 continue;
             }
 
@@ -442,27 +834,11 @@ void detect_objects(void)
                 objects[objectCount].distance = minDist;
                 objects[objectCount].linearWidth = linearWidth;
 
-                // Display object info
-                sprintf(buffer, "Object %d:\r\n", objectCount + 1);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Start angle: %.1f\r\n", startAngle);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - End angle: %.1f\r\n", endAngle);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Center angle: %.1f\r\n", centerAngle);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Radial width: %.1f degrees\r\n", radialWidth);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Distance: %.1f cm\r\n", minDist);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Linear width: %.1f cm\r\n\r\n", linearWidth);
-                send_uart_string(buffer);
+                // Log object info, the summary below goes to the console
+                LOG_DEBUG("Object %d: start %.1f, end %.1f, center %.1f degrees",
+                          objectCount + 1, log_float(startAngle), log_float(endAngle), log_float(centerAngle));
+                LOG_DEBUG("Object %d: radial width %.1f degrees, distance %.1f cm, linear width %.1f cm",
+                          objectCount + 1, log_float(radialWidth), log_float(minDist), log_float(linearWidth));
 
                 objectCount++;
             }
@@ -471,13 +847,13 @@ void detect_objects(void)
 
     // If still on an object at end of scan, properly end it
     if (onObject) {
-        int endIndex = NUM_POINTS - 1;
+        int endIndex = num_points - 1;
         float startAngle = angles[startIndex];
         float endAngle = angles[endIndex];
         float radialWidth = endAngle - startAngle;
 
         // Skip objects that are too narrow
-        if (radialWidth >= MIN_OBJECT_WIDTH) {
+        if (radialWidth >= min_object_width) {
             float centerAngle = (startAngle + endAngle) / 2.0f;
 
             // Find minimum PING distance within object
@@ -500,46 +876,47 @@ void detect_objects(void)
                 objects[objectCount].distance = minDist;
                 objects[objectCount].linearWidth = linearWidth;
 
-                // Display object info
-                sprintf(buffer, "Object %d (end of scan):\r\n", objectCount + 1);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Start angle: %.1f\r\n", startAngle);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - End angle: %.1f\r\n", endAngle);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Center angle: %.1f\r\n", centerAngle);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Radial width: %.1f degrees\r\n", radialWidth);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Distance: %.1f cm\r\n", minDist);
-                send_uart_string(buffer);
-
-                sprintf(buffer, "  - Linear width: %.1f cm\r\n\r\n", linearWidth);
-                send_uart_string(buffer);
+                // Log object info, the summary below goes to the console
+                LOG_DEBUG("Object %d (end of scan): start %.1f, end %.1f, center %.1f degrees",
+                          objectCount + 1, log_float(startAngle), log_float(endAngle), log_float(centerAngle));
+                LOG_DEBUG("Object %d: radial width %.1f degrees, distance %.1f cm, linear width %.1f cm",
+                          objectCount + 1, log_float(radialWidth), log_float(minDist), log_float(linearWidth));
 
                 objectCount++;
             }
         }
     }
 
-    // Summary of detected objects
-    if (objectCount > 0) {
+    // Summary of detected objects, one frame per object if telemetry is on
+    if (telemetry_enabled()) {
+        for (i = 0; i < objectCount; i++) {
+            telemetry_sendObject(i, objects[i].startAngle, objects[i].endAngle,
+                                 objects[i].distance, objects[i].linearWidth);
+        }
+    }
+    else if (objectCount > 0) {
         send_uart_string("Object Summary:\r\n");
 
         for (i = 0; i < objectCount; i++) {
-            sprintf(buffer, "Obj %d | Center: %3.1f | Distance: %5.1f | Linear Width: %5.1f\r\n",
-                    i+1, objects[i].centerAngle, objects[i].distance, objects[i].linearWidth);
+            fmt_t f;
+            fmt_init(&f, buffer, sizeof(buffer));
+            fmt_str(&f, "Obj ");
+            fmt_int(&f, i + 1, 0);
+            fmt_str(&f, " | Center: ");
+            fmt_float(&f, objects[i].centerAngle, 1, 3);
+            fmt_str(&f, " | Distance: ");
+            fmt_float(&f, objects[i].distance, 1, 5);
+            fmt_str(&f, " | Linear Width: ");
+            fmt_float(&f, objects[i].linearWidth, 1, 5);
+            fmt_str(&f, "\r\n");
             send_uart_string(buffer);
         }
         send_uart_string("\r\n");
     } else {
         send_uart_string("No objects detected.\r\n\r\n");
     }
+
+    profile_end(PROFILE_DETECT_OBJECTS);
 }
 
 // Calculate linear width using trigonometry: 2 * distance * sin(angle/2)
@@ -555,7 +932,131 @@ float calculate_linear_width(float radialWidth, float distance)
 // Send a string to UART
 void send_uart_string(const char *str)
 {
-    uart_sendStr(str);
+    chan_writeStr(CHAN_CONSOLE, str);
+}
+
+// Format one row of the scan table, same as "%3d        %6.1f                %4d\r\n"
+// Returns the length of the row
+int format_scan_line(char *line, int size, int angle, float ping, int ir)
+{
+    fmt_t f;
+    fmt_init(&f, line, size);
+    fmt_int(&f, angle, 3);
+    fmt_str(&f, "        ");
+    fmt_float(&f, ping, 1, 6);
+    fmt_str(&f, "                ");
+    fmt_int(&f, ir, 4);
+    fmt_str(&f, "\r\n");
+    return f.len;
+}
+
+// Send label, the value to one decimal place, then suffix
+void send_value(const char *label, float value, const char *suffix)
+{
+    char buffer[100];
+    fmt_t f;
+    fmt_init(&f, buffer, sizeof(buffer));
+    fmt_str(&f, label);
+    fmt_float(&f, value, 1, 0);
+    fmt_str(&f, suffix);
+    send_uart_string(buffer);
+}
+
+#if FORMAT_BENCHMARK
+// Format every point of the last scan with sprintf and then with fmt, each
+// in its own profile zone, and print the zones
+void benchmark_format(void)
+{
+    char line[48];
+    int i;
+
+    for (i = 0; i < num_points; i++) {
+        profile_begin(PROFILE_FMT_SPRINTF);
+        sprintf(line, "%3d        %6.1f                %4d\r\n",
+                (int)angles[i], ping_values[i], ir_values[i]);
+        profile_end(PROFILE_FMT_SPRINTF);
+
+        profile_begin(PROFILE_FMT_FIXED);
+        format_scan_line(line, sizeof(line), (int)angles[i], ping_values[i], ir_values[i]);
+        profile_end(PROFILE_FMT_FIXED);
+    }
+    profile_dump();
+}
+#endif
+
+// Measure how much CPU time it takes to send the last scan table through
+// the TX ring buffer and then through the uDMA. CPU time is elapsed time
+// minus time spent asleep waiting for the transmit to finish.
+void benchmark_scan_dump(void)
+{
+    char buffer[100];
+    uint64_t start, slept, busy[2], elapsed[2];
+    int length = 0;
+    int pass, i;
+
+    // Format the whole table up front so both passes send the same bytes
+    length += sprintf(scan_dump + length, "Angle   PING Distance (cm)   IR Value\r\n");
+    for (i = 0; i < num_points && length < SCAN_DUMP_SIZE - 40; i++) {
+        length += format_scan_line(scan_dump + length, SCAN_DUMP_SIZE - length,
+                                   (int)angles[i], ping_values[i], ir_values[i]);
+    }
+
+    chan_flush();
+    for (pass = 0; pass < 2; pass++) {
+        start = timer_getTicks();
+        slept = timer_getSleepTicks();
+
+        if (pass == 0) {
+            uart_sendBuf(scan_dump, length);
+            uart_txFlush();
+        }
+        else {
+            uart_sendDma(scan_dump, length, 0);
+            uart_dmaWait();
+            uart_txFlush();
+        }
+
+        elapsed[pass] = timer_getTicks() - start;
+        busy[pass] = elapsed[pass] - (timer_getSleepTicks() - slept);
+    }
+
+    sprintf(buffer, "\r\n%d bytes, CPU busy / elapsed:\r\n", length);
+    send_uart_string(buffer);
+    for (pass = 0; pass < 2; pass++) {
+        sprintf(buffer, "  %-9s %7luus / %7luus (%lu.%lu%%)\r\n",
+                pass == 0 ? "TX ring" : "uDMA",
+                (unsigned long)(busy[pass] / CLOCK_TICKS_PER_MICRO),
+                (unsigned long)(elapsed[pass] / CLOCK_TICKS_PER_MICRO),
+                (unsigned long)(busy[pass] * 100 / elapsed[pass]),
+                (unsigned long)(busy[pass] * 1000 / elapsed[pass] % 10));
+        send_uart_string(buffer);
+    }
+}
+
+// Wake condition for the command prompt: a byte over UART1, a button press
+// or log records to send
+int input_ready(void)
+{
+    return uart_rxReady() || button_hasEvent() || log_pending();
+}
+
+// Show the pose from the latest published snapshot on the LCD. Only reads
+// what the movement loops published, and only writes the LCD when a new
+// snapshot came in since the last call.
+void task_ui(void *arg)
+{
+    static uint32_t shown_seq;
+    oi_snapshot_t snapshot;
+    oi_pose_t pose;
+
+    if (oi_get_snapshot(&snapshot) == shown_seq) {
+        return;
+    }
+    shown_seq = snapshot.seq;
+
+    oi_getPose(&snapshot.sensors, &pose);
+    lcd_printf("x %5d mm\ny %5d mm\nheading %4d deg",
+               (int)pose.x, (int)pose.y, (int)(pose.theta * (180.0f / (float)M_PI)));
 }
 
 // Clear terminal using ANSI escape sequences
@@ -563,5 +1064,5 @@ void clear_terminal(void)
 {
     // ANSI escape sequence to clear screen and move cursor home
     char clearSeq[] = "\033[2J\033[H";
-    uart_sendStr(clearSeq);
+    send_uart_string(clearSeq);
 }
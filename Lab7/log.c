@@ -0,0 +1,173 @@
+/*
+ * log.c
+ *
+ * Deferred binary logging, see log.h for the record format
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include "driverlib/cpu.h" // for CPUcpsid, CPUcpsie
+#include "log.h"
+#include "Timer.h"
+#include "telemetry.h"
+
+#define LOG_RING_WORDS (LOG_BUFFER_SIZE / 4)
+#define LOG_RING_MASK  (LOG_RING_WORDS - 1)
+
+// Start of .logfmt, from the linker command file. Record IDs are offsets from here.
+extern const char __logfmt_start[];
+
+// Records are stored as whole words: header, timestamp, then the arguments.
+// head and tail run freely and are masked on every access.
+static uint32_t ring[LOG_RING_WORDS];
+static volatile uint32_t head = 0; // Next word to write, moved by log_write*()
+static volatile uint32_t tail = 0; // Next word to send, moved by log_flush()
+static log_stats_t stats;
+static volatile uint32_t unreported = 0; // Drops not yet recorded in the ring
+
+// Record how many records were dropped since the last report, so the host
+// sees the gap in the right place. Caller has interrupts masked and room
+// for 3 words.
+static uint32_t put_dropped(uint32_t at, uint32_t ticks)
+{
+    ring[at & LOG_RING_MASK] = (1u << 13) | LOG_ID_DROPPED;
+    ring[(at + 1) & LOG_RING_MASK] = ticks;
+    ring[(at + 2) & LOG_RING_MASK] = unreported;
+    unreported = 0;
+    return at + 3;
+}
+
+// Reserve room for one record and copy it in. Interrupts are masked so a
+// write from an ISR can't land in the middle of one from the main loop.
+static void log_write(const char *fmt, int count, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    uint32_t words = 2 + count;
+    uint32_t ticks = (uint32_t)timer_getTicks();
+    uint32_t was_masked = CPUcpsid();
+    uint32_t at = head;
+    uint32_t used = at - tail;
+
+    if (unreported != 0) {
+        words += 3; // Drop report goes in first
+    }
+    if (used + words > LOG_RING_WORDS) {
+        stats.dropped++;
+        unreported++;
+    }
+    else {
+        if (unreported != 0) {
+            at = put_dropped(at, ticks);
+        }
+        ring[at & LOG_RING_MASK] = ((uint32_t)count << 13) | (uint32_t)(fmt - __logfmt_start);
+        ring[(at + 1) & LOG_RING_MASK] = ticks;
+        switch (count) {
+        case 4: ring[(at + 5) & LOG_RING_MASK] = d; // fall through
+        case 3: ring[(at + 4) & LOG_RING_MASK] = c; // fall through
+        case 2: ring[(at + 3) & LOG_RING_MASK] = b; // fall through
+        case 1: ring[(at + 2) & LOG_RING_MASK] = a;
+        }
+        head = at + 2 + count;
+        stats.records++;
+        if ((used + words) * 4 > stats.peak) {
+            stats.peak = (used + words) * 4;
+        }
+    }
+
+    if (!was_masked) {
+        CPUcpsie();
+    }
+}
+
+void log_write0(const char *fmt)
+{
+    log_write(fmt, 0, 0, 0, 0, 0);
+}
+
+void log_write1(const char *fmt, uint32_t a)
+{
+    log_write(fmt, 1, a, 0, 0, 0);
+}
+
+void log_write2(const char *fmt, uint32_t a, uint32_t b)
+{
+    log_write(fmt, 2, a, b, 0, 0);
+}
+
+void log_write3(const char *fmt, uint32_t a, uint32_t b, uint32_t c)
+{
+    log_write(fmt, 3, a, b, c, 0);
+}
+
+void log_write4(const char *fmt, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    log_write(fmt, 4, a, b, c, d);
+}
+
+int log_pending(void)
+{
+    return head != tail || unreported != 0;
+}
+
+// Append a record to a frame body in wire order: u16 header, u32 words
+static int put_record(uint8_t *body, int len, uint32_t header, const uint32_t *words, int count)
+{
+    int i;
+    body[len++] = header & 0xFF;
+    body[len++] = (header >> 8) & 0xFF;
+    for (i = 0; i < count; i++) {
+        body[len++] = words[i] & 0xFF;
+        body[len++] = (words[i] >> 8) & 0xFF;
+        body[len++] = (words[i] >> 16) & 0xFF;
+        body[len++] = (words[i] >> 24) & 0xFF;
+    }
+    return len;
+}
+
+void log_flush(void)
+{
+    uint8_t body[TELEMETRY_LOG_SIZE];
+    uint32_t words[1 + LOG_MAX_ARGS];
+    uint32_t ticks = (uint32_t)timer_getTicks();
+    uint32_t was_masked = CPUcpsid();
+    int len = 0;
+
+    // Nothing has logged since the last drops, report them now
+    if (unreported != 0 && LOG_RING_WORDS - (head - tail) >= 3) {
+        head = put_dropped(head, ticks);
+    }
+    if (!was_masked) {
+        CPUcpsie();
+    }
+
+    while (head != tail) {
+        uint32_t at = tail;
+        uint32_t header = ring[at & LOG_RING_MASK];
+        uint32_t count = header >> 13;
+        uint32_t i;
+
+        for (i = 0; i < 1 + count; i++) {
+            words[i] = ring[(at + 1 + i) & LOG_RING_MASK];
+        }
+        tail = at + 2 + count;
+
+        // Send the frame so far if this record doesn't fit
+        if (len + 2 + 4 * (1 + (int)count) > TELEMETRY_LOG_SIZE) {
+            telemetry_sendLog(body, len);
+            len = 0;
+        }
+        len = put_record(body, len, header, words, 1 + count);
+    }
+
+    if (len > 0) {
+        telemetry_sendLog(body, len);
+    }
+}
+
+void log_getStats(log_stats_t *stats_out)
+{
+    uint32_t was_masked = CPUcpsid();
+    *stats_out = stats;
+    if (!was_masked) {
+        CPUcpsie();
+    }
+}
@@ -0,0 +1,133 @@
+/*
+ * log.h
+ *
+ * Deferred binary logging. A LOG_*() call stores its format string in the
+ * .logfmt section and only copies the string's offset, a timestamp and the
+ * raw argument words into a RAM ring buffer, so it costs a few dozen cycles
+ * instead of a formatted UART print. log_flush() sends the records as
+ * TELEMETRY_LOG frames, and tools/log_expand.py rebuilds the text on the
+ * host from the .logfmt section of the built .out file.
+ *
+ *     LOG_INFO("Turning right %.1f degrees", log_float(degrees));
+ *     LOG_DEBUG("Leading edge at %d (IR %d)", angle, ir);
+ *
+ * Up to LOG_MAX_ARGS integer arguments. Floats must be wrapped in
+ * log_float() and printed with %f, %e or %g. %s can't be used, the string
+ * would be gone by the time the host prints it.
+ *
+ * Calls below LOG_LEVEL compile to nothing, build with e.g.
+ * --define=LOG_LEVEL=LOG_LEVEL_WARN to strip debug and info logging.
+ *
+ * Record in the ring and on the wire, little-endian:
+ *   u16 (argument count << 13 | offset in .logfmt), u32 timer_getTicks()
+ *   low word, u32 per argument
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_NONE  4
+
+/// Lowest level compiled in
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+/// Size of the record ring buffer in bytes, must be a power of 2
+#define LOG_BUFFER_SIZE 2048
+
+/// Most arguments one LOG_*() call can take
+#define LOG_MAX_ARGS 4
+
+/// Offset reserved for the record stored ahead of the first record that fits
+/// after others were dropped, its one argument is how many. .logfmt must stay
+/// smaller than this.
+#define LOG_ID_DROPPED 0x1FFF
+
+/// Ring buffer counters
+typedef struct {
+    uint32_t records; // Records stored
+    uint32_t dropped; // Records thrown away because the ring buffer was full
+    uint32_t peak;    // Highest ring buffer occupancy in bytes
+} log_stats_t;
+
+// Every format string goes into .logfmt, first character is the level
+#define LOG_STRING __attribute__((section(".logfmt"), used))
+
+#define LOG_CAT(a, b) LOG_CAT_(a, b)
+#define LOG_CAT_(a, b) a##b
+#define LOG_FIRST(...) LOG_FIRST_(__VA_ARGS__, 0)
+#define LOG_FIRST_(fmt, ...) fmt
+#define LOG_COUNT(...) LOG_COUNT_(__VA_ARGS__, 4, 3, 2, 1, 0, 0)
+#define LOG_COUNT_(fmt, a, b, c, d, n, ...) n
+
+// Drop the format string literal and pass the arguments as words
+#define LOG_WRITE0(id, fmt) log_write0(id)
+#define LOG_WRITE1(id, fmt, a) log_write1(id, (uint32_t)(a))
+#define LOG_WRITE2(id, fmt, a, b) log_write2(id, (uint32_t)(a), (uint32_t)(b))
+#define LOG_WRITE3(id, fmt, a, b, c) log_write3(id, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c))
+#define LOG_WRITE4(id, fmt, a, b, c, d) log_write4(id, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d))
+
+#define LOG_AT(level, ...) do { \
+        static const char log_fmt[] LOG_STRING = level LOG_FIRST(__VA_ARGS__); \
+        LOG_CAT(LOG_WRITE, LOG_COUNT(__VA_ARGS__))(log_fmt, __VA_ARGS__); \
+    } while (0)
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT("D", __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do { } while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT("I", __VA_ARGS__)
+#else
+#define LOG_INFO(...) do { } while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...) LOG_AT("W", __VA_ARGS__)
+#else
+#define LOG_WARN(...) do { } while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG_AT("E", __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do { } while (0)
+#endif
+
+/// Pass a float to a LOG_*() call as its bit pattern
+static inline uint32_t log_float(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/// Store one record, safe to call from an ISR. Use the LOG_*() macros instead.
+void log_write0(const char *fmt);
+void log_write1(const char *fmt, uint32_t a);
+void log_write2(const char *fmt, uint32_t a, uint32_t b);
+void log_write3(const char *fmt, uint32_t a, uint32_t b, uint32_t c);
+void log_write4(const char *fmt, uint32_t a, uint32_t b, uint32_t c, uint32_t d);
+
+/// Returns 1 if records are waiting for log_flush()
+int log_pending(void);
+
+/// Send every waiting record over UART1, call from the main loop
+void log_flush(void);
+
+/// Copy the ring buffer counters
+void log_getStats(log_stats_t *stats);
+
+#endif /* LOG_H_ */
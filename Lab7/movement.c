@@ -10,83 +10,150 @@
 #include "movement.h"
 #include "Timer.h"
 #include "uart.h"
+#include "wdog.h"
+#include "telemetry.h"
+#include "log.h"
+
+// The movement loops only read the bumpers and the encoders, a 13 byte
+// stream packet instead of 84 for every sensor
+static const uint8_t motion_packets[] = {
+    OI_PACKET_BUMPS_WHEEL_DROPS,
+    OI_PACKET_LEFT_ENCODER,
+    OI_PACKET_RIGHT_ENCODER,
+    OI_PACKET_LIGHT_BUMPER,
+};
+static oi_profile_t motion_profile;
+
+void movement_init(void)
+{
+    if (oi_profileInit(&motion_profile, motion_packets, sizeof(motion_packets)) == 0) {
+        oi_setProfile(&motion_profile);
+    }
+}
+
+// Movement loops running, a move nested in another shares its stream
+static int motion_depth;
+
+/// Stream the motion profile while a movement loop runs
+static void motion_begin(void)
+{
+    if (motion_depth++ == 0) {
+        oi_streamStart();
+    }
+}
+
+/// Pause the stream when the outermost movement loop is done, so the CPU
+/// sleeps between moves instead of waking for every packet
+static void motion_end(void)
+{
+    if (motion_depth > 0 && --motion_depth == 0) {
+        oi_streamStop();
+    }
+}
 
 /**
  * Move the robot forward by the specified distance in millimeters
  */
-void move_forward(oi_t *sensor_data, double distance_mm)
+void move_forward(oi_t *sensor_data, float distance_mm)
 {
-    double sum = 0; // distance member in oi_t struct is type double, this tracks the total distance moved
-    distance_mm = distance_mm * 0.95; // makes up going too far
+    float start = sensor_data->odometer; // oi_update() keeps the total, measure from here
+    distance_mm = distance_mm * 0.95f; // makes up going too far
     oi_setWheels(100, 100); // move forward at full speed
 
-    // we loop until sum accumulates enough negative values to reach -distance
-    while (sum <= distance_mm)
+    wdog_begin(WDOG_MOVE, MOVE_WDOG_TIMEOUT_MS);
+    motion_begin();
+    while (sensor_data->odometer - start <= distance_mm)
     {
         oi_update(sensor_data); // update sensor data
-        sum += sensor_data->distance; // use -> notation since pointer, accumulates negative distance values
+        telemetry_sendOdometry(sensor_data);
+        if (wdog_feed()) {
+            break; // Watchdog stopped the wheels, give up on the move
+        }
     }
 
     oi_setWheels(0, 0); //stop
+    wdog_end();
+    motion_end();
     timer_waitMillis(500);
 }
 
 /**
  * Move the robot backward by the specified distance in millimeters
  */
-void move_backward(oi_t *sensor_data, double distance_mm)
+void move_backward(oi_t *sensor_data, float distance_mm)
 {
-    double sum = 0; // distance member in oi_t struct is type double, this tracks the total distance moved
+    float start = sensor_data->odometer; // oi_update() keeps the total, measure from here
     distance_mm = distance_mm; // makes up going too far
     oi_setWheels(-100, -100); // move forward at full speed
 
     // since robot is moving backwards, sensor_data->distance will be negative
-    // we loop until sum accumulates enough negative values to reach -distance
-    while (sum > -distance_mm)
+    // we loop until the odometer has gone down by distance
+    wdog_begin(WDOG_MOVE, MOVE_WDOG_TIMEOUT_MS);
+    motion_begin();
+    while (sensor_data->odometer - start > -distance_mm)
     {
         oi_update(sensor_data); // update sensor data
-        sum += sensor_data->distance; // use -> notation since pointer, accumulates negative distance values
+        telemetry_sendOdometry(sensor_data);
+        if (wdog_feed()) {
+            break; // Watchdog stopped the wheels, give up on the move
+        }
     }
 
     oi_setWheels(0, 0); //stop
+    wdog_end();
+    motion_end();
     timer_waitMillis(500);
 }
 
 /**
  * Turn the robot right by the specified angle in degrees
  */
-void turn_right(oi_t *sensor_data, double degrees)
+void turn_right(oi_t *sensor_data, float degrees)
 {
-    double sum = 0; // distance member in oi_t struct is type double
+    float start = sensor_data->heading; // oi_update() keeps the total, measure from here
     degrees = degrees * -1 + 17; // Calibration offset
     oi_setWheels(-100, 100); // turn speed
 
-    while (sum >= degrees)
+    wdog_begin(WDOG_TURN, MOVE_WDOG_TIMEOUT_MS);
+    motion_begin();
+    while (sensor_data->heading - start >= degrees)
     {
         oi_update(sensor_data);
-        sum += sensor_data->angle; // use -> notation since pointer
+        telemetry_sendOdometry(sensor_data);
+        if (wdog_feed()) {
+            break; // Watchdog stopped the wheels, give up on the move
+        }
     }
 
     oi_setWheels(0, 0); //stop
+    wdog_end();
+    motion_end();
     timer_waitMillis(500);
 }
 
 /**
  * Turn the robot left by the specified angle in degrees
  */
-void turn_left(oi_t *sensor_data, double degrees)
+void turn_left(oi_t *sensor_data, float degrees)
 {
     degrees -= 17; // Calibration offset
-    double sum = 0; // distance member in oi_t struct is type double
+    float start = sensor_data->heading; // oi_update() keeps the total, measure from here
     oi_setWheels(100, -100); //move forward at full speed
 
-    while (sum <= degrees)
+    wdog_begin(WDOG_TURN, MOVE_WDOG_TIMEOUT_MS);
+    motion_begin();
+    while (sensor_data->heading - start <= degrees)
     {
         oi_update(sensor_data);
-        sum += sensor_data->angle; // use -> notation since pointer
+        telemetry_sendOdometry(sensor_data);
+        if (wdog_feed()) {
+            break; // Watchdog stopped the wheels, give up on the move
+        }
     }
 
     oi_setWheels(0, 0); //stop
+    wdog_end();
+    motion_end();
     timer_waitMillis(500);
 }
 
@@ -111,18 +178,24 @@ void move_square(oi_t *sensor_data)
 /**
  * Move forward with obstacle avoidance
  */
-void move_forward_smart(oi_t *sensor_data, double distance_mm)
+void move_forward_smart(oi_t *sensor_data, float distance_mm)
 {
-    double distance_moved = 0;
+    float distance_moved = 0;
     int right_bump_status = 0;
     int left_bump_status = 0;
     int backup_distance = 150; //mm
     int bump_moveaway_distance = 250; //mm
     oi_setWheels(100, 100);
 
+    wdog_begin(WDOG_MOVE_SMART, MOVE_WDOG_TIMEOUT_MS);
+    motion_begin();
     while (distance_moved < distance_mm)
     {
         oi_update(sensor_data); //update sensor data
+        telemetry_sendOdometry(sensor_data);
+        if (wdog_feed()) {
+            break; // Watchdog stopped the wheels, give up on the move
+        }
         distance_moved += sensor_data->distance; //update distance value
         right_bump_status = sensor_data->bumpRight; //update the value of the right bump sensor
         left_bump_status = sensor_data->bumpLeft; //update the value of the left bump sensor
@@ -155,62 +228,85 @@ void move_forward_smart(oi_t *sensor_data, double distance_mm)
     }
 
     oi_setWheels(0, 0); //stop
+    wdog_end();
+    motion_end();
 }
 
 /**
  * Helper function: Move forward at a faster speed
  */
-void faster_move_forward(oi_t *sensor_data, double distance_mm)
+void faster_move_forward(oi_t *sensor_data, float distance_mm)
 {
-    double sum = 0;
-    distance_mm *= 0.95; // Adjustment factor
+    float start = sensor_data->odometer; // oi_update() keeps the total, measure from here
+    distance_mm *= 0.95f; // Adjustment factor
     oi_setWheels(200, 200); // Faster speed for go-around
 
-    while (sum <= distance_mm)
+    wdog_begin(WDOG_MOVE, MOVE_WDOG_TIMEOUT_MS);
+    motion_begin();
+    while (sensor_data->odometer - start <= distance_mm)
     {
         oi_update(sensor_data);
-        sum += sensor_data->distance;
+        telemetry_sendOdometry(sensor_data);
+        if (wdog_feed()) {
+            break; // Watchdog stopped the wheels, give up on the move
+        }
     }
 
     oi_setWheels(0, 0);
+    wdog_end();
+    motion_end();
     timer_waitMillis(300); // Shorter wait time
 }
 
 /**
  * Helper function: Turn right at a faster speed
  */
-void faster_turn_right(oi_t *sensor_data, double degrees)
+void faster_turn_right(oi_t *sensor_data, float degrees)
 {
-    double sum = 0;
+    float start = sensor_data->heading; // oi_update() keeps the total, measure from here
     degrees = degrees * -1 + 17; // Calibration offset
     oi_setWheels(-200, 200); // Faster turning
 
-    while (sum >= degrees)
+    wdog_begin(WDOG_TURN, MOVE_WDOG_TIMEOUT_MS);
+    motion_begin();
+    while (sensor_data->heading - start >= degrees)
     {
         oi_update(sensor_data);
-        sum += sensor_data->angle;
+        telemetry_sendOdometry(sensor_data);
+        if (wdog_feed()) {
+            break; // Watchdog stopped the wheels, give up on the move
+        }
     }
 
     oi_setWheels(0, 0);
+    wdog_end();
+    motion_end();
     timer_waitMillis(300);
 }
 
 /**
  * Helper function: Turn left at a faster speed
  */
-void faster_turn_left(oi_t *sensor_data, double degrees)
+void faster_turn_left(oi_t *sensor_data, float degrees)
 {
     degrees -= 17; // Calibration offset
-    double sum = 0;
+    float start = sensor_data->heading; // oi_update() keeps the total, measure from here
     oi_setWheels(200, -200); // Faster turning
 
-    while (sum <= degrees)
+    wdog_begin(WDOG_TURN, MOVE_WDOG_TIMEOUT_MS);
+    motion_begin();
+    while (sensor_data->heading - start <= degrees)
     {
         oi_update(sensor_data);
-        sum += sensor_data->angle;
+        telemetry_sendOdometry(sensor_data);
+        if (wdog_feed()) {
+            break; // Watchdog stopped the wheels, give up on the move
+        }
     }
 
     oi_setWheels(0, 0);
+    wdog_end();
+    motion_end();
     timer_waitMillis(300);
 }
 
@@ -221,12 +317,8 @@ void faster_turn_left(oi_t *sensor_data, double degrees)
  */
 int go_to_position(oi_t *sensor_data, float angle, float distance_cm)
 {
-    char buffer[100];
-
-    // DEBUGGING: Print the actual values coming in
-    sprintf(buffer, "DEBUG - Received: angle=%.1f, distance=%.1f\r\n", angle,
-            distance_cm);
-    uart_sendStr(buffer);
+    // DEBUGGING: Log the actual values coming in
+    LOG_DEBUG("Received: angle=%.1f, distance=%.1f", log_float(angle), log_float(distance_cm));
 
     // 1. Turn to face the target
     float degreesToTurn = 0;
@@ -234,36 +326,34 @@ int go_to_position(oi_t *sensor_data, float angle, float distance_cm)
     {
         // Object is to the right
         degreesToTurn = 90 - angle;
-        sprintf(buffer, "Turning right %.1f degrees\r\n", degreesToTurn);
-        uart_sendStr(buffer);
+        LOG_INFO("Turning right %.1f degrees", log_float(degreesToTurn));
 
         // Make sure the turn angle is sufficiently large to matter
-        if (degreesToTurn >= 2.0)
+        if (degreesToTurn >= 2.0f)
         {
             turn_right(sensor_data, degreesToTurn);
-            uart_sendStr("Turn completed\r\n");
+            LOG_DEBUG("Turn completed");
         }
         else
         {
-            uart_sendStr("Turn angle too small, skipping\r\n");
+            LOG_DEBUG("Turn angle too small, skipping");
         }
     }
     else if (angle > 90)
     {
         // Object is to the left
         degreesToTurn = angle - 90;
-        sprintf(buffer, "Turning left %.1f degrees\r\n", degreesToTurn);
-        uart_sendStr(buffer);
+        LOG_INFO("Turning left %.1f degrees", log_float(degreesToTurn));
 
         // Make sure the turn angle is sufficiently large to matter
-        if (degreesToTurn >= 2.0)
+        if (degreesToTurn >= 2.0f)
         {
             turn_left(sensor_data, degreesToTurn);
-            uart_sendStr("Turn completed\r\n");
+            LOG_DEBUG("Turn completed");
         }
         else
         {
-            uart_sendStr("Turn angle too small, skipping\r\n");
+            LOG_DEBUG("Turn angle too small, skipping");
         }
     }
 
@@ -273,7 +363,7 @@ int go_to_position(oi_t *sensor_data, float angle, float distance_cm)
     // Check if already close enough
     if (move_distance <= 0)
     {
-        uart_sendStr("Already close to object\r\n");
+        LOG_INFO("Already close to object");
         return 0;
     }
 
@@ -286,21 +376,25 @@ int go_to_position(oi_t *sensor_data, float angle, float distance_cm)
     // Convert to mm
     float move_distance_mm = move_distance * 10.0f;
 
-    // Print the intended movement
-    sprintf(buffer, "Moving forward %.1f cm (%.0f mm)\r\n", move_distance,
-            move_distance_mm);
-    uart_sendStr(buffer);
+    // Log the intended movement
+    LOG_INFO("Moving forward %.1f cm (%.0f mm)", log_float(move_distance), log_float(move_distance_mm));
 
     // 3. Move forward, watching for bumps
-    double distance_moved = 0;
+    float distance_moved = 0;
 
     // Start moving at normal speed for approaching objects
     oi_setWheels(100, 100);
     int right_bump_status = 0;
     int left_bump_status = 0;
+    wdog_begin(WDOG_GO_TO_POSITION, MOVE_WDOG_TIMEOUT_MS);
+    motion_begin();
     while (distance_moved < move_distance_mm)
     {
         oi_update(sensor_data); //update sensor data
+        telemetry_sendOdometry(sensor_data);
+        if (wdog_feed()) {
+            break; // Watchdog stopped the wheels, give up on the move
+        }
         distance_moved += sensor_data->distance; //update distance value
         right_bump_status = sensor_data->bumpRight; //update the value of the right bump sensor
         left_bump_status = sensor_data->bumpLeft; //update the value of the left bump sensor
@@ -317,14 +411,24 @@ int go_to_position(oi_t *sensor_data, float angle, float distance_cm)
                 go_around(sensor_data, 0);
             }
 
-            uart_sendStr("Navigation complete. Performing rescan...\r\n");
+            wdog_end();
+            motion_end();
+            LOG_INFO("Navigation complete. Performing rescan...");
             return 1; // Signal caller to rescan
         }
     }
 
 // Stop motion
     oi_setWheels(0, 0);
-    uart_sendStr("Reached target!\r\n");
+    if (wdog_tripped()) {
+        wdog_end();
+        motion_end();
+        LOG_WARN("Watchdog stopped the move, target not reached");
+        return 0;
+    }
+    wdog_end();
+    motion_end();
+    LOG_INFO("Reached target!");
 
     return 0; // No bumps occurred
 }
@@ -338,21 +442,21 @@ void go_around(oi_t *sensor_data, int left_or_right)
         move_backward(sensor_data, 150); // backup after collision
 
         // Hit left bumper - go around to the right
-        uart_sendStr("Going around to the right\r\n");
+        LOG_INFO("Going around to the right");
         faster_turn_right(sensor_data, 90);
-        uart_sendStr("Moving to the side (700mm)\r\n");
+        LOG_INFO("Moving to the side (700mm)");
         faster_move_forward(sensor_data, 700); // 700mm to the side
 
         faster_turn_left(sensor_data, 90); // Face forward again (north)
-        uart_sendStr("Moving forward past obstacle (1000mm)\r\n");
+        LOG_INFO("Moving forward past obstacle (1000mm)");
         faster_move_forward(sensor_data, 1200); // 1 meter forward --------------------------------------------------------TESTING-----------------------------------
 
         faster_turn_left(sensor_data, 90); // Turn toward original path (facing west)
-        uart_sendStr("Moving back toward original path (700mm)\r\n");
+        LOG_INFO("Moving back toward original path (700mm)");
         faster_move_forward(sensor_data, 700); // 700mm back toward path
 
         // PROPERLY FIXED: Now we're facing west, need to turn right 90 to face south
-        uart_sendStr("Turning right 90 degrees to face south\r\n");
+        LOG_INFO("Turning right 90 degrees to face south");
         faster_turn_left(sensor_data, 90);   // Turn right to face south
     }
     else
@@ -361,22 +465,22 @@ void go_around(oi_t *sensor_data, int left_or_right)
         move_backward(sensor_data, 150); // backup after collision
 
         // Hit right bumper - go around to the left
-        uart_sendStr("Going around to the left\r\n");
+        LOG_INFO("Going around to the left");
 
         faster_turn_left(sensor_data, 90);
-        uart_sendStr("Moving to the side (700mm)\r\n");
+        LOG_INFO("Moving to the side (700mm)");
         faster_move_forward(sensor_data, 700); // 700mm to the side
 
         faster_turn_right(sensor_data, 90); // Face forward again (north)
-        uart_sendStr("Moving forward past obstacle (1000mm)\r\n");
+        LOG_INFO("Moving forward past obstacle (1000mm)");
         faster_move_forward(sensor_data, 1200); // 1 meter forward --------------------------------------------------------TESTING-----------------------------------
 
         faster_turn_right(sensor_data, 90); // Turn toward original path (facing east)
-        uart_sendStr("Moving back toward original path (700mm)\r\n");
+        LOG_INFO("Moving back toward original path (700mm)");
         faster_move_forward(sensor_data, 700); // 700mm back toward path
 
         // PROPERLY FIXED: Now we're facing east, need to turn left 90 to face south
-        uart_sendStr("Turning left 90 degrees to face south\r\n");
+        LOG_INFO("Turning left 90 degrees to face south");
         faster_turn_right(sensor_data, 90);   // Turn left to face south
     }
 }
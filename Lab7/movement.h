@@ -18,17 +18,21 @@
 #define BACKUP_DISTANCE 150
 #define OBSTACLE_AVOID_DISTANCE 250
 #define STOP_DISTANCE 10.0  // Stop 10cm from the target object
+#define MOVE_WDOG_TIMEOUT_MS 1000 // Longest a movement loop can go without a sensor update, covers the 500ms settle after a nested move
+
+// Switch oi_update() to the bumper and encoder packets the movement loops read, call after oi_init()
+void movement_init(void);
 
 // Basic movement functions
-void move_forward(oi_t *sensor_data, double distance_mm);
-void move_backward(oi_t *sensor_data, double distance_mm);
-void turn_right(oi_t *sensor_data, double degrees);
-void turn_left(oi_t *sensor_data, double degrees);
+void move_forward(oi_t *sensor_data, float distance_mm);
+void move_backward(oi_t *sensor_data, float distance_mm);
+void turn_right(oi_t *sensor_data, float degrees);
+void turn_left(oi_t *sensor_data, float degrees);
 int go_to_position(oi_t *sensor_data, float angle, float distance_cm);
 void go_around(oi_t *sensor_data, int left_or_right);
 
 
 // Smart movement with obstacle avoidance
-void move_forward_smart(oi_t *sensor_data, double distance_mm);
+void move_forward_smart(oi_t *sensor_data, float distance_mm);
 
 #endif /* MOVEMENT_H_ */
@@ -16,6 +16,11 @@
  */
 
 #include "open_interface.h"
+#include "clock.h"
+#include "isrstat.h"
+#include "wdog.h"
+#include "profile.h"
+#include "driverlib/cpu.h" // for CPUcpsid, CPUcpsie, CPUprimask
 
 #define OI_OPCODE_START 128
 #define OI_OPCODE_BAUD 129
@@ -82,6 +87,68 @@
 
 #define SENSOR_PACKET_SIZE 80
 
+// Odometry constants in float, the FPU only does single precision
+#define OI_PI 3.14159265f
+#define OI_MM_PER_TICK (72.0f * OI_PI / 508.8f)            // 508.8 ticks per turn of a 72 mm wheel
+#define OI_RADIANS_PER_TICK (OI_MM_PER_TICK / 235.0f)      // One wheel's tick over the 235 mm wheel base
+
+// Stream packets are: header, byte count, then id and data for each packet
+// in the profile, then a checksum. All the bytes add up to 0.
+#define OI_STREAM_HEADER 19
+
+// Keeps the compiler from moving buffer accesses across a sequence number
+// read or write, so a seq can't be seen before the buffer it covers
+#ifdef __TI_COMPILER_VERSION__
+#define OI_BARRIER() __asm("    dmb")
+#else
+#define OI_BARRIER() __asm__ volatile("" ::: "memory")
+#endif
+
+/// Where UART4_Handler() is in a stream packet
+typedef enum {
+    STREAM_HEADER,
+    STREAM_COUNT,
+    STREAM_DATA,
+    STREAM_CHECKSUM
+} stream_state_t;
+
+// Data bytes of each packet id from 7 to 58, in group 100 order
+static const uint8_t packet_sizes[] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 7-18
+    2, 2, 1, 2, 2, 1, 2, 2,             // 19-26
+    2, 2, 2, 2, 2, 1, 2,                // 27-33
+    1, 1, 1, 1, 1,                      // 34-38
+    2, 2, 2, 2, 2, 2, 1,                // 39-45
+    2, 2, 2, 2, 2, 2, 1, 1,             // 46-53
+    2, 2, 2, 2, 1                       // 54-58
+};
+#define OI_PACKET_FIRST 7
+#define OI_PACKET_LAST 58
+
+// Default profile, every sensor
+static const oi_profile_t profile_full = {1, {OI_PACKET_GROUP100}, SENSOR_PACKET_SIZE};
+static const oi_profile_t *profile = &profile_full;
+
+static volatile int streaming;
+static volatile int stream_closing; // oi_close() paused the stream from an ISR, oi_update() finishes the stop
+static volatile int query_holdoff;  // Set after a full query until a wheel timer says the next one may go
+static volatile uint8_t stream_expect = 1 + SENSOR_PACKET_SIZE; // Byte count for the current profile
+static uint8_t stream_packets[2][OI_PROFILE_MAX_BYTES];       // The ISR fills one while the other holds the latest packet
+static uint8_t stream_lengths[2];                             // Bytes in each of stream_packets
+static volatile uint8_t stream_latest;                        // Index of the latest complete packet
+static volatile uint32_t stream_seq;                  // Good packets since reset
+static uint32_t stream_read;                          // stream_seq when oi_update() last copied a packet
+static oi_stream_stats_t stream_stats;
+
+// Snapshots published by oi_update(), snapshot_seq & 1 is the latest
+static oi_snapshot_t snapshots[2];
+static volatile uint32_t snapshot_seq;
+
+// Parser state, only touched by UART4_Handler() while streaming
+static stream_state_t stream_state;
+static uint8_t stream_sum;
+static uint8_t stream_count;
+
 float motor_cal_factor_L = 1.00;
 float motor_cal_factor_R = 1.00;
 
@@ -109,16 +176,41 @@ void uart_sendStr(const char *theData);
 char oi_uartReceive(void);
 
 /// Parse data from iRobot into oi_t struct
-void oi_parsePacket(oi_t *self, uint8_t packet[]);
+/// The data is a query list reply for format, or a stream packet with ids if format is NULL
+void oi_parsePacket(oi_t *self, const oi_profile_t *format, const uint8_t packet[], int len);
+
+/// Integrate the encoder counts into distance, angle and the pose
+/// internal function
+static void oi_updateOdometry(oi_t *self);
+
+/// Parse one sensor packet into oi_t struct
+/// internal function
+static void oi_parseSensor(oi_t *self, uint8_t id, const uint8_t *data);
+
+/// Returns the data bytes of a sensor packet, 0 for ids we don't parse
+/// internal function
+static int oi_packetSize(uint8_t id);
+
+/// Tell the Create to stop streaming, safe in an ISR
+/// internal function
+static void oi_streamPause(void);
 
 /// Send large data set from array
 ///	internal function
 void oi_uartSendBuff(const uint8_t theData[], uint8_t theSize);
 
+/// Send a whole command with interrupts masked
+/// internal function
+static void oi_uartSendCmd(const uint8_t cmd[], uint8_t size);
+
+/// Send opcode followed by the profile's packet ids
+/// internal function
+static void oi_sendPacketList(uint8_t opcode);
+
 /// Helper function to convert big-endian integer from pointer into little
 /// endian integer
 /// internal function
-int16_t oi_parseInt(uint8_t *theInt);
+int16_t oi_parseInt(const uint8_t *theInt);
 
 /// Allocate and clear all memory for OI Struct
 oi_t *oi_alloc()
@@ -167,129 +259,529 @@ void oi_init(oi_t *self)
 
 void oi_close()
 {
+    if (CPUprimask() || (NVIC_INT_CTRL_R & NVIC_INT_CTRL_VEC_ACT_M)) {
+        // Can't wait out the last packet here, pause the Create and leave
+        // the rest of the stop to oi_update()
+        if (streaming) {
+            oi_streamPause();
+            stream_closing = 1;
+        }
+    }
+    else {
+        oi_streamStop();
+    }
     oi_setWheels(0, 0);
     oi_uartSendChar(OI_OPCODE_STOP);
 }
 
-/// Update all sensor and store in oi_t struct
-void oi_update(oi_t *self)
+/// Returns 1 once the ISR has a packet oi_update() hasn't read, or the stream is closing
+static int oi_streamFresh(void)
+{
+    return stream_seq != stream_read || stream_closing;
+}
+
+/// Tell the Create to stop sending stream packets
+static void oi_streamPause(void)
+{
+    const uint8_t cmd[] = {OI_OPCODE_DO_STREAM, 0}; // Pause
+    oi_uartSendCmd(cmd, sizeof(cmd));
+}
+
+/// Wheel timer callback, the next full query may be sent
+static void oi_queryReady(void)
+{
+    query_holdoff = 0;
+}
+
+static int oi_queryAllowed(void)
 {
-    uint8_t sensorBuffer[SENSOR_PACKET_SIZE];
+    return !query_holdoff;
+}
 
-    // Query list of sensors
-    oi_uartSendChar(OI_OPCODE_SENSORS);
-    oi_uartSendChar(OI_SENSOR_PACKET_GROUP100);
+/// Stop parsing stream packets once the Create has been paused, thread context only
+static void oi_streamTeardown(void)
+{
+    // Let the ISR take the rest of a packet that was already on its way,
+    // then drop whatever is left so the next query starts clean
+    timer_waitMillis(OI_STREAM_PERIOD_MS);
+    UART4_IM_R &= ~(UART_IM_RXIM | UART_IM_RTIM);
+    streaming = 0;
+    stream_closing = 0;
+    while (!(UART4_FR_R & UART_FR_RXFE)) {
+        (void)UART4_DR_R;
+    }
+}
 
-    // Read all the sensor data
-    uint8_t i;
-    for (i = 0; i < SENSOR_PACKET_SIZE; i++) {
-        // read each sensor byte
-        sensorBuffer[i] = oi_uartReceive();
+/// Ask for the profile's packets every 15 ms, replaces any stream the Create is already sending
+static void oi_streamRequest(void)
+{
+    oi_sendPacketList(OI_OPCODE_STREAM);
+}
+
+void oi_streamStart(void)
+{
+    if (stream_closing) {
+        oi_streamTeardown();
     }
 
-    // Parse the sensor data into the struct
-    oi_parsePacket(self, sensorBuffer);
+    uint32_t was_masked = CPUcpsid();
+
+    memset(&stream_stats, 0, sizeof(stream_stats));
+    stream_state = STREAM_HEADER;
+    stream_read = stream_seq;
+    streaming = 1;
+
+    // Throw away anything left over from a query
+    while (!(UART4_FR_R & UART_FR_RXFE)) {
+        (void)UART4_DR_R;
+    }
+    UART4_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC;
+    UART4_IM_R |= UART_IM_RXIM | UART_IM_RTIM;
 
-    timer_waitMillis(25); // reduces USART errors that occur when continuously
-                          // transmitting/receiving min wait time=15ms
+    if (!was_masked) {
+        CPUcpsie();
+    }
+
+    oi_streamRequest();
 }
 
-void oi_parsePacket(oi_t *self, uint8_t packet[])
+void oi_streamStop(void)
 {
-    self->wheelDropLeft = !!(packet[0] & 0x08);
-    self->wheelDropRight = !!(packet[0] & 0x04);
-    self->bumpLeft = !!(packet[0] & 0x02);
-    self->bumpRight = packet[0] & 0x01;
+    if (!streaming) {
+        return;
+    }
 
-    self->wallSensor = packet[1];
+    if (!stream_closing) {
+        oi_streamPause();
+    }
+    oi_streamTeardown();
+}
 
-    self->cliffLeft = packet[2];
-    self->cliffFrontLeft = packet[3];
-    self->cliffFrontRight = packet[4];
-    self->cliffRight = packet[5];
+uint32_t oi_streamSeq(void)
+{
+    return stream_seq;
+}
 
-    self->virtualWall = packet[6];
+int oi_profileInit(oi_profile_t *new_profile, const uint8_t ids[], int num_ids)
+{
+    int size = 0;
+    int i;
 
-    self->overcurrentLeftWheel = !!(packet[7] & 0x10);
-    self->overcurrentRightWheel = !!(packet[7] & 0x08);
-    self->overcurrentMainBrush = !!(packet[7] & 0x04);
-    self->overcurrentSideBrush = packet[7] & 0x01;
+    if (num_ids < 1 || num_ids > OI_PROFILE_MAX_PACKETS) {
+        return -1;
+    }
+    for (i = 0; i < num_ids; i++) {
+        int packet_size = oi_packetSize(ids[i]);
+        if (packet_size == 0) {
+            return -1;
+        }
+        size += packet_size;
+    }
+    if (size + num_ids > OI_PROFILE_MAX_BYTES) {
+        return -1;
+    }
 
-    self->dirtDetect = packet[8];
+    memcpy(new_profile->ids, ids, num_ids);
+    new_profile->num_packets = num_ids;
+    new_profile->size = size;
+    return 0;
+}
 
-    // Byte 9 unused
+void oi_setProfile(const oi_profile_t *new_profile)
+{
+    if (!new_profile) {
+        new_profile = &profile_full;
+    }
 
-    self->infraredCharOmni = packet[10];
+    uint32_t was_masked = CPUcpsid();
+    profile = new_profile;
+    stream_expect = profile->size + profile->num_packets;
+    stream_state = STREAM_HEADER;
+    if (!was_masked) {
+        CPUcpsie();
+    }
 
-    self->buttonClock = !!(packet[11] & 0x80);
-    self->buttonSchedule = !!(packet[11] & 0x40);
-    self->buttonDay = !!(packet[11] & 0x20);
-    self->buttonHour = !!(packet[11] & 0x10);
-    self->buttonMinute = !!(packet[11] & 0x08);
-    self->buttonDock = !!(packet[11] & 0x04);
-    self->buttonSpot = !!(packet[11] & 0x02);
-    self->buttonClean = packet[11] & 0x01;
+    if (streaming) {
+        // Packets already on their way have the old byte count and are dropped
+        oi_streamRequest();
+    }
+}
 
-    self->chargingState = packet[16];
-    self->batteryVoltage = oi_parseInt(packet + 17);
-    self->batteryCurrent = oi_parseInt(packet + 19);
-    self->batteryTemperature = packet[21];
-    self->batteryCharge = oi_parseInt(packet + 22);
-    self->batteryCapacity = oi_parseInt(packet + 24);
+void oi_getStreamStats(oi_stream_stats_t *stats)
+{
+    uint32_t was_masked = CPUcpsid();
+    *stats = stream_stats;
+    if (!was_masked) {
+        CPUcpsie();
+    }
+}
 
-    self->wallSignal = oi_parseInt(packet + 26);
+/// Publish a copy of the sensor data as the latest snapshot
+/// internal function
+static void oi_publish(const oi_t *self)
+{
+    uint32_t seq = snapshot_seq + 1;
+    oi_snapshot_t *next = &snapshots[seq & 1]; // Readers are copying the other one
+
+    next->sensors = *self;
+    next->seq = seq;
+    next->time_ms = timer_getMillis();
+    OI_BARRIER();
+    snapshot_seq = seq;
+}
 
-    self->cliffLeftSignal = oi_parseInt(packet + 28);
-    self->cliffFrontLeftSignal = oi_parseInt(packet + 30);
-    self->cliffFrontRightSignal = oi_parseInt(packet + 32);
-    self->cliffRightSignal = oi_parseInt(packet + 34);
+/// Read the latest stream packet, or query the profile's sensors, then parse
+/// and publish it. internal function
+static void oi_readPacket(oi_t *self)
+{
+    uint8_t sensorBuffer[OI_PROFILE_MAX_BYTES];
+    const oi_profile_t *format;
+    int len;
+
+    if (streaming) {
+        uint32_t seq;
+        do {
+            // The ISR only writes the buffer that isn't latest, and bumps
+            // stream_seq when it flips, so an unchanged seq means a whole copy
+            seq = stream_seq;
+            uint8_t latest = stream_latest;
+            OI_BARRIER();
+            len = stream_lengths[latest];
+            memcpy(sensorBuffer, stream_packets[latest], len);
+            OI_BARRIER();
+        } while (seq != stream_seq);
+        stream_read = seq;
+        format = NULL; // Stream packets carry their ids
+    }
+    else {
+        // Query list of sensors, once the last full query has had its gap
+        timer_idleUntil(UINT64_MAX, oi_queryAllowed);
+        oi_sendPacketList(OI_OPCODE_QUERY_LIST);
+
+        // Read all the sensor data
+        uint8_t i;
+        for (i = 0; i < profile->size; i++) {
+            // read each sensor byte
+            sensorBuffer[i] = oi_uartReceive();
+        }
+        len = profile->size;
+        format = profile;
+
+        if (profile == &profile_full) {
+            // Leave 25ms before the next query, reduces USART errors that occur when
+            // continuously transmitting/receiving, min wait time=15ms. The caller
+            // goes on with the data and only a query that comes too soon waits.
+            query_holdoff = 1;
+            if (timer_fireOnce(oi_queryReady, 25) < 0) {
+                timer_waitMillis(25); // No wheel timer free
+                query_holdoff = 0;
+            }
+        }
+    }
 
-    // Bytes 36-38 unused
+    // Parse the sensor data into the struct
+    oi_parsePacket(self, format, sensorBuffer, len);
+    oi_publish(self);
+}
 
-    self->chargingSourcesAvailable = packet[39];
-    self->oiMode = packet[40];
+/// Update the profile's sensors and store in oi_t struct
+void oi_update(oi_t *self)
+{
+    profile_begin(PROFILE_OI_UPDATE);
+
+    if (streaming && !stream_closing) {
+        // Sleep until UART4_Handler() has a packet we haven't read yet
+        if (!timer_idleUntil(timer_getTicks() + OI_STREAM_TIMEOUT_MS * CLOCK_TICKS_PER_MILLI,
+                             oi_streamFresh)) {
+            // The Create dropped out of stream mode or a packet was corrupted,
+            // ask again and reuse the last packet, which reports no movement
+            stream_stats.timeouts++;
+            oi_streamRequest();
+
+            if (stream_stats.packets == 0) {
+                // Nothing to parse yet
+                self->distance = 0;
+                self->angle = 0;
+                profile_end(PROFILE_OI_UPDATE);
+                return;
+            }
+        }
+    }
+    if (stream_closing) {
+        // oi_close() ran in an ISR, finish stopping the stream and query instead
+        oi_streamTeardown();
+    }
+
+    oi_readPacket(self);
+
+    profile_end(PROFILE_OI_UPDATE);
+}
+
+int oi_update_async(oi_t *self)
+{
+    // Querying, or finishing a stop oi_close() left, would mean waiting,
+    // so both are left to oi_update()
+    if (!streaming || stream_closing || !oi_streamFresh()) {
+        return 0;
+    }
 
-    self->songNumber = packet[41];
-    self->songPlaying = packet[42];
+    profile_begin(PROFILE_OI_UPDATE);
+    oi_readPacket(self);
+    profile_end(PROFILE_OI_UPDATE);
+    return 1;
+}
 
-    self->numberOfStreamPackets = packet[43];
+uint32_t oi_get_snapshot(oi_snapshot_t *snapshot)
+{
+    uint32_t seq;
+
+    do {
+        // oi_publish() only writes the buffer that isn't latest, so the copy
+        // is whole unless another snapshot was published meanwhile
+        seq = snapshot_seq;
+        OI_BARRIER();
+        *snapshot = snapshots[seq & 1];
+        OI_BARRIER();
+    } while (seq != snapshot_seq);
+
+    return seq;
+}
 
-    self->requestedVelocity = oi_parseInt(packet + 44);
-    self->requestedRadius = oi_parseInt(packet + 46);
-    self->requestedRightVelocity = oi_parseInt(packet + 48);
-    self->requestedLeftVelocity = oi_parseInt(packet + 50);
-    self->leftEncoderCount = oi_parseInt(packet + 52);
-    self->rightEncoderCount = oi_parseInt(packet + 54);
+void oi_parsePacket(oi_t *self, const oi_profile_t *format, const uint8_t packet[], int len)
+{
+    int pos = 0;
+    int n = 0;
+    int encoders = 0;
 
-    self->lightBumperRight = !!(packet[56] & 0x20);
-    self->lightBumperFrontRight = !!(packet[56] & 0x10);
-    self->lightBumperCenterRight = !!(packet[56] & 0x08);
-    self->lightBumperCenterLeft = !!(packet[56] & 0x04);
-    self->lightBumperFrontLeft = !!(packet[56] & 0x02);
-    self->lightBumperLeft = packet[56] & 0x01;
+    profile_begin(PROFILE_OI_PARSE_PACKET);
 
-    self->lightBumpLeftSignal = oi_parseInt(packet + 57);
-    self->lightBumpFrontLeftSignal = oi_parseInt(packet + 59);
-    self->lightBumpCenterLeftSignal = oi_parseInt(packet + 61);
-    self->lightBumpCenterRightSignal = oi_parseInt(packet + 63);
-    self->lightBumpFrontRightSignal = oi_parseInt(packet + 65);
-    self->lightBumpRightSignal = oi_parseInt(packet + 67);
+    while (pos < len) {
+        uint8_t id;
+        if (format) {
+            if (n == format->num_packets) {
+                break;
+            }
+            id = format->ids[n++];
+        }
+        else {
+            id = packet[pos++];
+        }
 
-    self->infraredCharLeft = packet[69];
-    self->infraredCharRight = packet[70];
+        int size = oi_packetSize(id);
+        if (size == 0 || pos + size > len) {
+            break; // Left over from another profile, or corrupted
+        }
+        oi_parseSensor(self, id, packet + pos);
+        pos += size;
 
-    self->leftMotorCurrent = oi_parseInt(packet + 71);
-    self->rightMotorCurrent = oi_parseInt(packet + 73);
-    self->mainBrushMotorCurrent = oi_parseInt(packet + 75);
-    self->sideBrushMotorCurrent = oi_parseInt(packet + 77);
+        if (id == OI_PACKET_GROUP100) {
+            encoders = 2;
+        }
+        else if (id == OI_PACKET_LEFT_ENCODER || id == OI_PACKET_RIGHT_ENCODER) {
+            encoders++;
+        }
+    }
 
-    self->stasis = packet[79];
+    if (encoders == 2) {
+        oi_updateOdometry(self);
+    }
+    else {
+        self->distance = 0;
+        self->angle = 0;
+    }
 
-    self->distance = oi_getDistance(self);
-    self->angle = oi_getDegrees(self);
+    profile_end(PROFILE_OI_PARSE_PACKET);
 }
 
-inline int16_t oi_parseInt(uint8_t *theInt)
+static int oi_packetSize(uint8_t id)
+{
+    if (id == OI_PACKET_GROUP100) {
+        return SENSOR_PACKET_SIZE;
+    }
+    if (id < OI_PACKET_FIRST || id > OI_PACKET_LAST) {
+        return 0;
+    }
+    return packet_sizes[id - OI_PACKET_FIRST];
+}
+
+static void oi_parseSensor(oi_t *self, uint8_t id, const uint8_t *data)
+{
+    switch (id) {
+    case 7:
+        self->wheelDropLeft = !!(data[0] & 0x08);
+        self->wheelDropRight = !!(data[0] & 0x04);
+        self->bumpLeft = !!(data[0] & 0x02);
+        self->bumpRight = data[0] & 0x01;
+        break;
+    case 8:
+        self->wallSensor = data[0];
+        break;
+    case 9:
+        self->cliffLeft = data[0];
+        break;
+    case 10:
+        self->cliffFrontLeft = data[0];
+        break;
+    case 11:
+        self->cliffFrontRight = data[0];
+        break;
+    case 12:
+        self->cliffRight = data[0];
+        break;
+    case 13:
+        self->virtualWall = data[0];
+        break;
+    case 14:
+        self->overcurrentLeftWheel = !!(data[0] & 0x10);
+        self->overcurrentRightWheel = !!(data[0] & 0x08);
+        self->overcurrentMainBrush = !!(data[0] & 0x04);
+        self->overcurrentSideBrush = data[0] & 0x01;
+        break;
+    case 15:
+        self->dirtDetect = data[0];
+        break;
+    case 17:
+        self->infraredCharOmni = data[0];
+        break;
+    case 18:
+        self->buttonClock = !!(data[0] & 0x80);
+        self->buttonSchedule = !!(data[0] & 0x40);
+        self->buttonDay = !!(data[0] & 0x20);
+        self->buttonHour = !!(data[0] & 0x10);
+        self->buttonMinute = !!(data[0] & 0x08);
+        self->buttonDock = !!(data[0] & 0x04);
+        self->buttonSpot = !!(data[0] & 0x02);
+        self->buttonClean = data[0] & 0x01;
+        break;
+    case 21:
+        self->chargingState = data[0];
+        break;
+    case 22:
+        self->batteryVoltage = oi_parseInt(data);
+        break;
+    case 23:
+        self->batteryCurrent = oi_parseInt(data);
+        break;
+    case 24:
+        self->batteryTemperature = data[0];
+        break;
+    case 25:
+        self->batteryCharge = oi_parseInt(data);
+        break;
+    case 26:
+        self->batteryCapacity = oi_parseInt(data);
+        break;
+    case 27:
+        self->wallSignal = oi_parseInt(data);
+        break;
+    case 28:
+        self->cliffLeftSignal = oi_parseInt(data);
+        break;
+    case 29:
+        self->cliffFrontLeftSignal = oi_parseInt(data);
+        break;
+    case 30:
+        self->cliffFrontRightSignal = oi_parseInt(data);
+        break;
+    case 31:
+        self->cliffRightSignal = oi_parseInt(data);
+        break;
+    case 34:
+        self->chargingSourcesAvailable = data[0];
+        break;
+    case 35:
+        self->oiMode = data[0];
+        break;
+    case 36:
+        self->songNumber = data[0];
+        break;
+    case 37:
+        self->songPlaying = data[0];
+        break;
+    case 38:
+        self->numberOfStreamPackets = data[0];
+        break;
+    case 39:
+        self->requestedVelocity = oi_parseInt(data);
+        break;
+    case 40:
+        self->requestedRadius = oi_parseInt(data);
+        break;
+    case 41:
+        self->requestedRightVelocity = oi_parseInt(data);
+        break;
+    case 42:
+        self->requestedLeftVelocity = oi_parseInt(data);
+        break;
+    case 43:
+        self->leftEncoderCount = oi_parseInt(data);
+        break;
+    case 44:
+        self->rightEncoderCount = oi_parseInt(data);
+        break;
+    case 45:
+        self->lightBumperRight = !!(data[0] & 0x20);
+        self->lightBumperFrontRight = !!(data[0] & 0x10);
+        self->lightBumperCenterRight = !!(data[0] & 0x08);
+        self->lightBumperCenterLeft = !!(data[0] & 0x04);
+        self->lightBumperFrontLeft = !!(data[0] & 0x02);
+        self->lightBumperLeft = data[0] & 0x01;
+        break;
+    case 46:
+        self->lightBumpLeftSignal = oi_parseInt(data);
+        break;
+    case 47:
+        self->lightBumpFrontLeftSignal = oi_parseInt(data);
+        break;
+    case 48:
+        self->lightBumpCenterLeftSignal = oi_parseInt(data);
+        break;
+    case 49:
+        self->lightBumpCenterRightSignal = oi_parseInt(data);
+        break;
+    case 50:
+        self->lightBumpFrontRightSignal = oi_parseInt(data);
+        break;
+    case 51:
+        self->lightBumpRightSignal = oi_parseInt(data);
+        break;
+    case 52:
+        self->infraredCharLeft = data[0];
+        break;
+    case 53:
+        self->infraredCharRight = data[0];
+        break;
+    case 54:
+        self->leftMotorCurrent = oi_parseInt(data);
+        break;
+    case 55:
+        self->rightMotorCurrent = oi_parseInt(data);
+        break;
+    case 56:
+        self->mainBrushMotorCurrent = oi_parseInt(data);
+        break;
+    case 57:
+        self->sideBrushMotorCurrent = oi_parseInt(data);
+        break;
+    case 58:
+        self->stasis = data[0];
+        break;
+    case OI_PACKET_GROUP100: {
+        // Packets 7-58 back to back
+        uint8_t packet_id;
+        for (packet_id = OI_PACKET_FIRST; packet_id <= OI_PACKET_LAST; packet_id++) {
+            oi_parseSensor(self, packet_id, data);
+            data += packet_sizes[packet_id - OI_PACKET_FIRST];
+        }
+        break;
+    }
+    default:
+        // 16, 32 and 33 are unused, 19 and 20 are replaced by the encoders
+        break;
+    }
+}
+
+inline int16_t oi_parseInt(const uint8_t *theInt)
 {
     return (theInt[0] << 8) | theInt[1];
 }
@@ -301,17 +793,14 @@ inline int16_t oi_parseInt(uint8_t *theInt)
 /// \param power_intensity (0-255) 0=off, 255=full intensity
 void oi_setLeds(uint8_t play_led, uint8_t advance_led, uint8_t power_color, uint8_t power_intensity)
 {
-    // LED Opcode
-    oi_uartSendChar(OI_OPCODE_LEDS);
-
-    // Set the Play and Advance LEDs
-    oi_uartSendChar(advance_led << 3 && play_led << 2);
-
-    // Set the power led color
-    oi_uartSendChar(power_color);
-
-    // Set the power led intensity
-    oi_uartSendChar(power_intensity);
+    const uint8_t cmd[] = {
+        OI_OPCODE_LEDS,                   // LED Opcode
+        advance_led << 3 && play_led << 2, // Set the Play and Advance LEDs
+        power_color,                      // Set the power led color
+        power_intensity,                  // Set the power led intensity
+    };
+
+    oi_uartSendCmd(cmd, sizeof(cmd));
 }
 
 /// \brief Set direction and speed of the robot's wheels
@@ -321,11 +810,15 @@ void oi_setWheels(int16_t right_wheel, int16_t left_wheel)
 {
     right_wheel = right_wheel * motor_cal_factor_R;
     left_wheel = left_wheel * motor_cal_factor_L;
-    oi_uartSendChar(OI_OPCODE_DRIVE_WHEELS);
-    oi_uartSendChar(right_wheel >> 8);
-    oi_uartSendChar(right_wheel & 0xff);
-    oi_uartSendChar(left_wheel >> 8);
-    oi_uartSendChar(left_wheel & 0xff);
+
+    const uint8_t cmd[] = {
+        OI_OPCODE_DRIVE_WHEELS,
+        right_wheel >> 8,
+        right_wheel & 0xff,
+        left_wheel >> 8,
+        left_wheel & 0xff,
+    };
+    oi_uartSendCmd(cmd, sizeof(cmd));
 }
 
 /// \brief Load song sequence
@@ -335,20 +828,26 @@ void oi_setWheels(int16_t right_wheel, int16_t left_wheel)
 /// \param A pointer to a sequence of durations that correspond to the notes
 void oi_loadSong(int song_index, int num_notes, unsigned char *notes, unsigned char *duration)
 {
+    uint8_t cmd[3 + 2 * 16];
     int i;
-    oi_uartSendChar(OI_OPCODE_SONG);
-    oi_uartSendChar(song_index);
-    oi_uartSendChar(num_notes);
+
+    if (num_notes > 16) {
+        num_notes = 16;
+    }
+    cmd[0] = OI_OPCODE_SONG;
+    cmd[1] = song_index;
+    cmd[2] = num_notes;
     for (i = 0; i < num_notes; i++) {
-        oi_uartSendChar(notes[i]);
-        oi_uartSendChar(duration[i]);
+        cmd[3 + 2 * i] = notes[i];
+        cmd[4 + 2 * i] = duration[i];
     }
+    oi_uartSendCmd(cmd, 3 + 2 * num_notes);
 }
 
 /// Plays a given song; use oi_load_song(...) first
 void oi_play_song(int index) {
-    oi_uartSendChar(OI_OPCODE_PLAY);
-    oi_uartSendChar(index);
+    const uint8_t cmd[] = {OI_OPCODE_PLAY, index};
+    oi_uartSendCmd(cmd, sizeof(cmd));
 }
 
 /// Runs default go charge program; robot will search for dock
@@ -374,10 +873,10 @@ void go_charge(void) {
 void oi_uartInit(void)
 {
     // Calculated Baudrate for 115200;
-    uint16_t iBRD = 0x08; // BRD=SYSCLK/((ClkDiv)(BaudRate)), HSE=0 ClkDiv=16,
-                          // BaudRate=115,200
+    uint16_t iBRD = CLOCK_UART_IBRD(115200); // BRD=SYSCLK/((ClkDiv)(BaudRate)), HSE=0 ClkDiv=16,
+                                             // BaudRate=115,200
     uint16_t fBRD =
-        44; // Fractional remainder is 0.6805, DIVFRAC = (.6805)(64)+0.5 = 44
+        CLOCK_UART_FBRD(115200); // Fractional remainder * 64, rounded
 
     SYSCTL_RCGCGPIO_R |= SYSCTL_RCGCGPIO_R2; // enable GPIO Port C
 
@@ -395,10 +894,78 @@ void oi_uartInit(void)
     UART4_IBRD_R = iBRD;
     UART4_FBRD_R = fBRD;
 
-    UART4_LCRH_R = UART_LCRH_WLEN_8; // 8 bit, 1 stop, no parity, no FIFO
+    UART4_LCRH_R = UART_LCRH_WLEN_8 | UART_LCRH_FEN; // 8 bit, 1 stop, no parity, FIFO on
+    UART4_IFLS_R = UART_IFLS_RX4_8;  // RX interrupt at half full, RX timeout catches the tail of a packet
+    UART4_IM_R = 0;                  // RX interrupts are unmasked by oi_streamStart()
     UART4_CC_R = UART_CC_CS_SYSCLK;  // Use System Clock
     UART4_CTL_R = UART_CTL_RXE | UART_CTL_TXE |
                   UART_CTL_UARTEN; // Enable Rx, Tx and UART module
+
+    // UART4 is IRQ 60, priority 2 in bits 5-7 of PRI15, below UART1
+    NVIC_PRI15_R = (NVIC_PRI15_R & 0xFFFFFF1F) | 0x00000040;
+    NVIC_EN1_R |= (1 << (60 - 32));
+    IntRegister(INT_UART4, UART4_Handler);
+}
+
+void UART4_Handler(void)
+{
+    uint32_t entry = isrstat_enter(ISRSTAT_UART4, ISRSTAT_NO_LATENCY);
+
+    UART4_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC;
+
+    while (!(UART4_FR_R & UART_FR_RXFE)) {
+        uint32_t data = UART4_DR_R;
+        uint8_t byte = data & 0xFF;
+
+        if (data & (UART_DR_OE | UART_DR_FE | UART_DR_PE | UART_DR_BE)) {
+            // The packet being assembled is missing a byte, look for the next header
+            stream_stats.errors++;
+            stream_state = STREAM_HEADER;
+        }
+
+        stream_sum += byte;
+
+        switch (stream_state) {
+        case STREAM_HEADER:
+            if (byte == OI_STREAM_HEADER) {
+                stream_sum = byte;
+                stream_state = STREAM_COUNT;
+            }
+            break;
+        case STREAM_COUNT:
+            if (byte == stream_expect) {
+                stream_count = 0;
+                stream_state = STREAM_DATA;
+            }
+            else {
+                stream_stats.bad++;
+                stream_state = STREAM_HEADER;
+            }
+            break;
+        case STREAM_DATA:
+            stream_packets[stream_latest ^ 1][stream_count++] = byte;
+            if (stream_count == stream_expect) {
+                stream_state = STREAM_CHECKSUM;
+            }
+            break;
+        case STREAM_CHECKSUM:
+            if (stream_sum == 0) {
+                // Publish the packet and fill the other buffer next
+                stream_lengths[stream_latest ^ 1] = stream_count;
+                OI_BARRIER();
+                stream_latest ^= 1;
+                stream_seq++;
+                stream_stats.packets++;
+            }
+            else {
+                stream_stats.bad++;
+            }
+            stream_state = STREAM_HEADER;
+            break;
+        }
+    }
+
+    isrstat_exit(ISRSTAT_UART4, entry);
 }
 
 /// transmit character
@@ -419,8 +986,12 @@ char oi_uartReceive(void)
     // uint32_t tempData; //used for error checking
     char data;
 
-    while ((UART4_FR_R & UART_FR_RXFE))
-        ; // wait here until data is recieved
+    while ((UART4_FR_R & UART_FR_RXFE)) {
+        // wait here until data is recieved, unless the watchdog has given up on the caller
+        if (wdog_tripped()) {
+            return 0;
+        }
+    }
 
     data = (char)(UART4_DR_R & 0xFF);
 
@@ -448,6 +1019,30 @@ void oi_uartSendBuff(const uint8_t theData[], uint8_t theSize)
     }
 }
 
+/// The watchdog and the shutoff button send commands from ISRs. Masking for
+/// the whole command keeps theirs from landing in the middle of ours, at most
+/// 35 bytes for a song, about 2ms once the FIFO is full.
+static void oi_uartSendCmd(const uint8_t cmd[], uint8_t size)
+{
+    uint32_t was_masked = CPUcpsid();
+
+    oi_uartSendBuff(cmd, size);
+
+    if (!was_masked) {
+        CPUcpsie();
+    }
+}
+
+static void oi_sendPacketList(uint8_t opcode)
+{
+    uint8_t cmd[2 + OI_PROFILE_MAX_PACKETS];
+
+    cmd[0] = opcode;
+    cmd[1] = profile->num_packets;
+    memcpy(&cmd[2], profile->ids, profile->num_packets);
+    oi_uartSendCmd(cmd, 2 + profile->num_packets);
+}
+
 char *oi_checkFirmware()
 {
     const char FIRM_STR[] = "r3_robot/tags/";
@@ -507,95 +1102,206 @@ void oi_shutoff_init(void)
 
 void GPIOF_Handler(void)
 {
+    uint32_t entry = isrstat_enter(ISRSTAT_GPIOF, ISRSTAT_NO_LATENCY);
+
     if (GPIO_PORTF_RIS_R & BIT0) {
         // shutoff button was pressed, turn off OI
         oi_close();
 
         GPIO_PORTF_ICR_R |= BIT0; // clear interrupt
     }
-}
 
-/**
- * Get the moved degrees from the previous call of oi_update
- * @author Isaac Rex
- *
- * @param self oi sensor
- */
-static double oi_getDegrees(oi_t *self)
-{
-    return oi_getRadians(self) * 180.00 / M_PI;
+    isrstat_exit(ISRSTAT_GPIOF, entry);
 }
 
 /**
- * @brief Get the moved radians from the previous call of oi_update
- * @author Isaac Rex
+ * @brief Works out the distance and angle moved since the last encoder
+ * counts and integrates them into the pose. The counts are 16 bit and wrap,
+ * the difference is taken modulo 2^16 so a wrap between updates is a small
+ * step, not a jump of 65536 ticks.
  *
  * @param self Sensor data pointer
- * @return double number of radians turned since last call of oi_update
  */
-static double oi_getRadians(oi_t *self)
+static void oi_updateOdometry(oi_t *self)
 {
-    static int first_pass = 1;
-    static int prevLeft = 0;
-    static int prevRight = 0;
+    if (!self->odometryValid) {
+        // First counts, nothing to compare against yet
+        self->odometryLeft = self->leftEncoderCount;
+        self->odometryRight = self->rightEncoderCount;
+        self->odometryValid = 1;
+        self->distance = 0;
+        self->angle = 0;
+        return;
+    }
 
-    if ((self->leftEncoderCount == prevLeft) &&
-        (self->rightEncoderCount == prevRight)) {
-        prevLeft = self->leftEncoderCount;
-        prevRight = self->rightEncoderCount;
-        return 0;
+    int16_t leftEncoderDiff = (int16_t)(uint16_t)(self->leftEncoderCount - self->odometryLeft);
+    int16_t rightEncoderDiff = (int16_t)(uint16_t)(self->rightEncoderCount - self->odometryRight);
+    self->odometryLeft = self->leftEncoderCount;
+    self->odometryRight = self->rightEncoderCount;
+
+    // Distance is the average of both wheels, radians = (distanceRight - distanceLeft) / wheel-base
+    float distance = (leftEncoderDiff + rightEncoderDiff) * (OI_MM_PER_TICK / 2.0f);
+    float radians = (rightEncoderDiff - leftEncoderDiff) * OI_RADIANS_PER_TICK;
+
+    // Move along the heading halfway through the turn, exact for a straight
+    // line and close for the short arcs between 15 ms updates
+    float mid = self->theta + radians / 2.0f;
+    self->x += distance * cosf(mid);
+    self->y += distance * sinf(mid);
+
+    self->theta += radians;
+    if (self->theta > OI_PI) {
+        self->theta -= 2.0f * OI_PI;
     }
-    // ignore the first run, such that we do not have prevLeft or right=0, this
-    // would give a very large degree moved.
-    else if (first_pass) {
-        // Gets processed durint oi_init()
-        prevLeft = self->leftEncoderCount;
-        prevRight = self->rightEncoderCount;
-        first_pass = 0;
-        return 0;
+    else if (self->theta <= -OI_PI) {
+        self->theta += 2.0f * OI_PI;
     }
 
-    // get distance moved in mm for the left and right wheel
-    // equation: ticks * (1/508.8)*72pi
-    int16_t leftEncoderDiff = self->leftEncoderCount - prevLeft;
-    int16_t rightEncoderDiff = self->rightEncoderCount - prevRight;
-    // 508.8 encoder ticks per wheel revolution, wheel is 72π mm diameter
-    double distLeft = (leftEncoderDiff) * (72.00 * M_PI / 508.8);
-    double distRight = (rightEncoderDiff) * (72.00 * M_PI / 508.8);
-    prevLeft = self->leftEncoderCount;
-    prevRight = self->rightEncoderCount;
+    self->distance = distance;
+    self->angle = radians * (180.0f / OI_PI);
 
-    // Radians = (distanceRight - distanceLeft) / wheel-base (per datatsheet)
-    double radians = (distRight - distLeft) / 235.00;
-    return (radians);
+    // Totals come from whole ticks so rounding doesn't build up over a mission
+    self->travelTicks += leftEncoderDiff + rightEncoderDiff;
+    self->turnTicks += rightEncoderDiff - leftEncoderDiff;
+    self->odometer = self->travelTicks * (OI_MM_PER_TICK / 2.0f);
+    self->heading = self->turnTicks * (OI_RADIANS_PER_TICK * 180.0f / OI_PI);
 }
 
-/**
- * @brief Returns the average distance traveled by each wheel since the last
- * call to oi_update
- * @author Isaac Rex
- *
- * @param self oi sensor
- * @return double average distance travled by each wheel since last call to oi_update()
- */
-static double oi_getDistance(oi_t *self)
+void oi_getPose(const oi_t *self, oi_pose_t *pose)
 {
-    static int prevLeft = 0;
-    static int prevRight = 0;
+    pose->x = self->x;
+    pose->y = self->y;
+    pose->theta = self->theta;
+}
 
-    // get distance moved in mm for the left and right wheel
-    // equation: ticks * (1/508.8)*72pi
-    // update the previous values to be correct
-    int16_t leftEncoderDiff = self->leftEncoderCount - prevLeft;
-    int16_t rightEncoderDiff = self->rightEncoderCount - prevRight;
-    double distLeft = (leftEncoderDiff) * (72 * M_PI / 508.8);
-    double distRight = (rightEncoderDiff) * (72 * M_PI / 508.8);
-    prevLeft = self->leftEncoderCount;
-    prevRight = self->rightEncoderCount;
+void oi_resetPose(oi_t *self)
+{
+    self->x = 0;
+    self->y = 0;
+    self->theta = 0;
+    self->odometer = 0;
+    self->heading = 0;
+    self->travelTicks = 0;
+    self->turnTicks = 0;
+}
 
-    // Total distance is average of both wheels' distance
-    return (distLeft + distRight) / 2.00;
+float oi_distanceTo(const oi_t *self, float x, float y)
+{
+    return hypotf(x - self->x, y - self->y);
+}
+
+float oi_bearingTo(const oi_t *self, float x, float y)
+{
+    float turn = atan2f(y - self->y, x - self->x) - self->theta;
+
+    if (turn > OI_PI) {
+        turn -= 2.0f * OI_PI;
+    }
+    else if (turn <= -OI_PI) {
+        turn += 2.0f * OI_PI;
+    }
+    return turn * (180.0f / OI_PI);
+}
+
+#if OI_ODOMETRY_BENCHMARK
+// Odometry as it was in doubles, kept to time and check the float version
+typedef struct {
+    double x;
+    double y;
+    double theta;
+    double heading;
+    int16_t left;
+    int16_t right;
+} odometry_double_t;
+
+static void oi_odometryDouble(odometry_double_t *odom, int16_t left, int16_t right)
+{
+    int16_t leftEncoderDiff = (int16_t)(uint16_t)(left - odom->left);
+    int16_t rightEncoderDiff = (int16_t)(uint16_t)(right - odom->right);
+    odom->left = left;
+    odom->right = right;
+
+    double distLeft = leftEncoderDiff * (72.00 * M_PI / 508.8);
+    double distRight = rightEncoderDiff * (72.00 * M_PI / 508.8);
+    double distance = (distLeft + distRight) / 2.00;
+    double radians = (distRight - distLeft) / 235.00;
+
+    double mid = odom->theta + radians / 2.00;
+    odom->x += distance * cos(mid);
+    odom->y += distance * sin(mid);
+
+    odom->theta += radians;
+    if (odom->theta > M_PI) {
+        odom->theta -= 2.00 * M_PI;
+    }
+    else if (odom->theta <= -M_PI) {
+        odom->theta += 2.00 * M_PI;
+    }
+    odom->heading += radians * 180.00 / M_PI;
+}
+
+void oi_benchmarkOdometry(int updates, float *max_position, float *max_heading)
+{
+    static const uint8_t ids[] = {
+        OI_PACKET_BUMPS_WHEEL_DROPS, OI_PACKET_LEFT_ENCODER, OI_PACKET_RIGHT_ENCODER, OI_PACKET_LIGHT_BUMPER
+    };
+    oi_profile_t motion;
+    oi_t sensors;
+    odometry_double_t reference;
+    uint8_t packet[6] = {0};
+    int16_t left = 32000; // Both encoders wrap early in the drive
+    int16_t right = -32000;
+    int i;
+
+    oi_profileInit(&motion, ids, sizeof(ids));
+    memset(&sensors, 0, sizeof(sensors));
+    memset(&reference, 0, sizeof(reference));
+    reference.left = left;
+    reference.right = right;
+    sensors.leftEncoderCount = left;
+    sensors.rightEncoderCount = right;
+    oi_updateOdometry(&sensors);
+    *max_position = 0;
+    *max_heading = 0;
+
+    for (i = 0; i < updates; i++) {
+        // About 200 mm/s, weaving left and right, with a spin now and then
+        if (i % 400 < 40) {
+            left -= 7;
+            right += 7;
+        }
+        else {
+            left += 7 + (i / 50) % 3;
+            right += 7 + (i / 70) % 3;
+        }
+        packet[1] = (uint16_t)left >> 8;
+        packet[2] = left & 0xFF;
+        packet[3] = (uint16_t)right >> 8;
+        packet[4] = right & 0xFF;
+
+        profile_begin(PROFILE_ODOMETRY_FLOAT);
+        oi_parsePacket(&sensors, &motion, packet, sizeof(packet));
+        profile_end(PROFILE_ODOMETRY_FLOAT);
+
+        profile_begin(PROFILE_ODOMETRY_DOUBLE);
+        oi_parseSensor(&sensors, OI_PACKET_BUMPS_WHEEL_DROPS, packet);
+        oi_parseSensor(&sensors, OI_PACKET_LEFT_ENCODER, packet + 1);
+        oi_parseSensor(&sensors, OI_PACKET_RIGHT_ENCODER, packet + 3);
+        oi_parseSensor(&sensors, OI_PACKET_LIGHT_BUMPER, packet + 5);
+        oi_odometryDouble(&reference, sensors.leftEncoderCount, sensors.rightEncoderCount);
+        profile_end(PROFILE_ODOMETRY_DOUBLE);
+
+        float position = (float)hypot(sensors.x - reference.x, sensors.y - reference.y);
+        float heading = (float)fabs(sensors.heading - reference.heading);
+        if (position > *max_position) {
+            *max_position = position;
+        }
+        if (heading > *max_heading) {
+            *max_heading = heading;
+        }
+    }
 }
+#endif
 
 /**
  * @brief Sets the calibration factor for each of the motors. Defualt is 1
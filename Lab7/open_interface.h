@@ -34,6 +34,44 @@
 #define BIT6        0x40
 #define BIT7        0x80
 
+/// Sensor packet ids for query lists and streams, see the Create 2 OI spec
+#define OI_PACKET_BUMPS_WHEEL_DROPS 7
+#define OI_PACKET_WALL 8
+#define OI_PACKET_CLIFF_LEFT 9
+#define OI_PACKET_CLIFF_FRONT_LEFT 10
+#define OI_PACKET_CLIFF_FRONT_RIGHT 11
+#define OI_PACKET_CLIFF_RIGHT 12
+#define OI_PACKET_BUTTONS 18
+#define OI_PACKET_BATTERY_VOLTAGE 22
+#define OI_PACKET_BATTERY_CHARGE 25
+#define OI_PACKET_BATTERY_CAPACITY 26
+#define OI_PACKET_CLIFF_LEFT_SIGNAL 28
+#define OI_PACKET_CLIFF_FRONT_LEFT_SIGNAL 29
+#define OI_PACKET_CLIFF_FRONT_RIGHT_SIGNAL 30
+#define OI_PACKET_CLIFF_RIGHT_SIGNAL 31
+#define OI_PACKET_OI_MODE 35
+#define OI_PACKET_LEFT_ENCODER 43
+#define OI_PACKET_RIGHT_ENCODER 44
+#define OI_PACKET_LIGHT_BUMPER 45
+#define OI_PACKET_LIGHT_BUMP_LEFT_SIGNAL 46 // 46-51 are the six light bump signals, left to right
+#define OI_PACKET_LIGHT_BUMP_RIGHT_SIGNAL 51
+#define OI_PACKET_STASIS 58
+#define OI_PACKET_GROUP100 100 // Every packet from 7 to 58, 80 bytes
+
+/// Most packets in a sensor profile
+#define OI_PROFILE_MAX_PACKETS 16
+
+/// Most bytes in a profile's stream packet, data and ids, enough for group 100 on its own
+#define OI_PROFILE_MAX_BYTES 81
+
+/// The sensor packets oi_update() asks the Create for. Only the oi_t fields
+/// of those packets are updated, the rest keep their last values.
+typedef struct {
+    uint8_t num_packets;                 // Entries in ids
+    uint8_t ids[OI_PROFILE_MAX_PACKETS]; // Packet ids, in the order the Create sends them
+    uint8_t size;                        // Data bytes in one reply, not counting ids
+} oi_profile_t;
+
 /// iRobot Create Sensor Data
 typedef struct {
 	//Boolean sensor values
@@ -95,8 +133,8 @@ typedef struct {
 	int16_t sideBrushMotorCurrent;
 
 	//Motion sensors
-	double distance;
-	double angle;
+	float distance;  // mm since the last update
+	float angle;     // Degrees since the last update, counterclockwise is positive
 	int8_t requestedVelocity;
 	int8_t requestedRadius;
 	int16_t requestedRightVelocity;
@@ -127,8 +165,34 @@ typedef struct {
 	uint8_t numberOfStreamPackets;
 	uint8_t stasis;
 
+	//Odometry, integrated by every oi_update() that reads both encoders
+	float x;                // mm forward of where oi_init() or oi_resetPose() left the robot
+	float y;                // mm to the left of it
+	float theta;            // Heading in radians, -pi to pi, counterclockwise is positive
+	float odometer;         // mm driven along the path, driving backwards counts down
+	float heading;          // Degrees turned, not wrapped, counterclockwise is positive
+	int32_t travelTicks;    // Left plus right encoder ticks since the reset, odometer is worked out from these
+	int32_t turnTicks;      // Right minus left encoder ticks since the reset, heading is worked out from these
+	int16_t odometryLeft;   // Encoder counts the pose was last integrated at
+	int16_t odometryRight;
+	uint8_t odometryValid;  // Set once the first encoder counts are in
+
 } oi_t;
 
+/// A copy of the sensor data published by oi_update() or oi_update_async()
+typedef struct {
+	oi_t sensors;     // Sensor data and odometry as of this update
+	uint32_t seq;     // Counts published updates, 0 before the first one
+	uint32_t time_ms; // timer_getMillis() when the data was parsed
+} oi_snapshot_t;
+
+/// Robot position from the encoders
+typedef struct {
+	float x;     // mm, +x is the heading at the last reset
+	float y;     // mm, +y is to the left
+	float theta; // radians, -pi to pi
+} oi_pose_t;
+
 
 ///Allocate and clear all memory for OI Struct
 oi_t * oi_alloc();
@@ -140,11 +204,83 @@ void oi_free(oi_t *self);
 ///Initialize open interface
 void oi_init(oi_t *self);
 
+///Stop the wheels and the OI. Safe in an ISR, a running stream is then only
+///paused and the next oi_update() finishes stopping it.
 void oi_close();
 
-///Update sensor data
+///Update sensor data. While streaming, sleeps until a packet newer than
+///the last one read arrives (at most OI_STREAM_TIMEOUT_MS) instead of
+///querying and waiting on every byte.
+///Also publishes the data, see oi_get_snapshot().
 void oi_update(oi_t *self);
 
+/**
+ * Update the sensor data if there is something new, without waiting. Only
+ * parses a stream packet UART4_Handler() has finished and publishes it for
+ * oi_get_snapshot(). Never queries, so it does nothing unless streaming.
+ * @return 1 if self was updated and a snapshot published, 0 if nothing new
+ */
+int oi_update_async(oi_t *self);
+
+/**
+ * Copy the latest published sensor data. Safe from any context and never
+ * masks interrupts; one update can be shared by every reader instead of
+ * each calling oi_update(). Only one oi_t should be updating at a time.
+ * @param snapshot Filled in with the latest snapshot
+ * @return the snapshot's seq, compare with an earlier one to see if it is new, 0 if none yet
+ */
+uint32_t oi_get_snapshot(oi_snapshot_t *snapshot);
+
+/// The Create sends a stream packet every 15 ms
+#define OI_STREAM_PERIOD_MS 15
+
+/// Longest oi_update() waits for a stream packet before restarting the stream
+#define OI_STREAM_TIMEOUT_MS 60
+
+/// Sensor stream counters since oi_streamStart()
+typedef struct {
+    uint32_t packets;  // Packets that passed the checksum
+    uint32_t bad;      // Packets with a wrong length or checksum
+    uint32_t errors;   // Bytes with framing, parity, break or overrun errors
+    uint32_t timeouts; // oi_update() calls that got no new packet in time, each restarts the stream
+} oi_stream_stats_t;
+
+/// Start streaming the profile's packets every OI_STREAM_PERIOD_MS, parsed by UART4_Handler().
+/// Each packet wakes the CPU, so only stream while something needs fresh sensors,
+/// the movement loops start and stop it around each move.
+void oi_streamStart(void);
+
+/// Pause the stream and go back to querying in oi_update()
+void oi_streamStop(void);
+
+/// Returns the number of good stream packets received, increments every 15 ms while streaming
+uint32_t oi_streamSeq(void);
+
+/// Copy the stream counters
+void oi_getStreamStats(oi_stream_stats_t *stats);
+
+/// UART4 RX interrupt, assembles stream packets
+void UART4_Handler(void);
+
+/**
+ * Build a sensor profile from a list of packet ids, e.g. bumps and encoders:
+ *     {OI_PACKET_BUMPS_WHEEL_DROPS, OI_PACKET_LEFT_ENCODER, OI_PACKET_RIGHT_ENCODER}
+ * distance and angle are only updated if the profile has both encoders.
+ * @param profile Profile to fill in
+ * @param ids Packet ids 7-58 or OI_PACKET_GROUP100
+ * @param num_ids Entries in ids, at most OI_PROFILE_MAX_PACKETS
+ * @return 0, or -1 for an unknown id or a reply over OI_PROFILE_MAX_BYTES
+ */
+int oi_profileInit(oi_profile_t *profile, const uint8_t ids[], int num_ids);
+
+/**
+ * Choose the packets oi_update() fetches, with a query list (opcode 149),
+ * or by restarting the stream if it is running. The profile is used in
+ * place and must stay valid.
+ * @param profile Profile from oi_profileInit(), or NULL for every sensor (group 100)
+ */
+void oi_setProfile(const oi_profile_t *profile);
+
 /// \brief Set the LEDS on the Create
 /// \param play_led 0=off, 1=on
 /// \param advance_led 0=off, 1=on
@@ -181,14 +317,17 @@ void oi_shutoff_init(void);
 //used to handle interrupt to shut off OI
 void GPIOF_Handler(void);
 
-//used to get the current moved degrees from encoder count
-static double oi_getDegrees(oi_t *self);
+/// Copy the pose integrated from the encoders
+void oi_getPose(const oi_t *self, oi_pose_t *pose);
+
+/// Make the current position the origin, facing +x, and zero the odometer and heading
+void oi_resetPose(oi_t *self);
 
-// Get the number of radians moved since last call
-static double oi_getRadians(oi_t *self);
+/// Returns the straight line distance in mm from the current position to (x, y)
+float oi_distanceTo(const oi_t *self, float x, float y);
 
-// Gets the distance moved since the last call to getDistance
-static double oi_getDistance(oi_t *self);
+/// Returns the turn in degrees, -180 to 180, that faces (x, y) from the current pose
+float oi_bearingTo(const oi_t *self, float x, float y);
 
 // Sets the calibration factor for the motors. Defualt is 1
 void oi_setMotorCalibration(double left, double right);
@@ -199,4 +338,23 @@ double oi_getMotorCalibrationLeft(void);
 // Gets the encoder calibration for the right encoder
 double oi_getMotorCalibrationRight(void);
 
+// Build oi_benchmarkOdometry(), which times the float odometry against the
+// double version it replaced. Set to 1 to build it, off by default so the
+// double math stays out of the program.
+#define OI_ODOMETRY_BENCHMARK 0
+
+#if OI_ODOMETRY_BENCHMARK
+/**
+ * Feed a made-up drive through the motion packet parse and odometry, once
+ * with the float odometry and once with the old double version, timed in
+ * the PROFILE_ODOMETRY_FLOAT and PROFILE_ODOMETRY_DOUBLE zones. The float
+ * pose stays within 0.1 mm and 0.001 degrees of the double one over 40000
+ * updates, ten minutes of streaming.
+ * @param updates Packets to feed, 4000 is a minute of streaming
+ * @param max_position Largest x/y difference between the two, in mm
+ * @param max_heading Largest heading difference, in degrees
+ */
+void oi_benchmarkOdometry(int updates, float *max_position, float *max_heading);
+#endif
+
 #endif /* OPEN_INTERFACE_H_ */
@@ -0,0 +1,118 @@
+/*
+ * profile.c
+ *
+ * Cycle-count profiling zones using the Cortex-M4 DWT cycle counter
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stdio.h>
+#include "profile.h"
+#include "uart.h"
+
+// Core debug registers, not part of tm4c123gh6pm.h
+#define CORE_DEMCR_R    (*((volatile uint32_t *)0xE000EDFC)) // Debug Exception and Monitor Control
+#define DWT_CTRL_R      (*((volatile uint32_t *)0xE0001000)) // DWT Control
+#define DWT_CYCCNT_R    (*((volatile uint32_t *)0xE0001004)) // DWT Cycle Count
+
+#define CORE_DEMCR_TRCENA   0x01000000 // Enables the DWT unit
+#define DWT_CTRL_CYCCNTENA  0x00000001 // Enables CYCCNT
+
+static profile_stats_t zones[PROFILE_NUM_ZONES];
+
+// Names printed by profile_dump(), in the same order as profile_zone_t.
+// At most 16 characters so the columns line up.
+static const char *zone_names[PROFILE_NUM_ZONES] = {
+    "oi_update",
+    "oi_parsePacket",
+    "scan_all_angles",
+    "detect_objects",
+    "uart_sendStr",
+    "line sprintf",
+    "line fmt",
+    "odometry double",
+    "odometry float",
+};
+
+void profile_init(void)
+{
+    CORE_DEMCR_R |= CORE_DEMCR_TRCENA;  // Turn on the DWT unit
+    DWT_CYCCNT_R = 0;                   // Start the cycle count at 0
+    DWT_CTRL_R |= DWT_CTRL_CYCCNTENA;   // Start counting cycles
+
+    profile_reset();
+}
+
+void profile_reset(void)
+{
+    int i;
+    for (i = 0; i < PROFILE_NUM_ZONES; i++) {
+        zones[i].count = 0;
+        zones[i].min = 0xFFFFFFFF;
+        zones[i].max = 0;
+        zones[i].total = 0;
+        zones[i].start = 0;
+    }
+}
+
+void profile_begin(profile_zone_t zone)
+{
+    zones[zone].start = DWT_CYCCNT_R;
+}
+
+void profile_end(profile_zone_t zone)
+{
+    // Unsigned subtraction handles CYCCNT wrapping once between begin and end
+    uint32_t cycles = DWT_CYCCNT_R - zones[zone].start;
+    profile_stats_t *z = &zones[zone];
+
+    z->count++;
+    z->total += cycles;
+    if (cycles < z->min) {
+        z->min = cycles;
+    }
+    if (cycles > z->max) {
+        z->max = cycles;
+    }
+}
+
+const profile_stats_t *profile_getStats(profile_zone_t zone)
+{
+    return &zones[zone];
+}
+
+void profile_dump(void)
+{
+    // Copy the table first so printing through uart_sendStr, which is
+    // itself a zone, does not change the numbers being printed
+    profile_stats_t snapshot[PROFILE_NUM_ZONES];
+    char buffer[100];
+    int i;
+
+    for (i = 0; i < PROFILE_NUM_ZONES; i++) {
+        snapshot[i] = zones[i];
+    }
+
+    uart_sendStr("\r\nZone               Count        Min        Max        Avg   Total(kcyc)\r\n");
+    uart_sendStr("------------------------------------------------------------------------\r\n");
+
+    for (i = 0; i < PROFILE_NUM_ZONES; i++) {
+        profile_stats_t *z = &snapshot[i];
+
+        if (z->count == 0) {
+            sprintf(buffer, "%-16s %7d          -          -          -             0\r\n",
+                    zone_names[i], 0);
+        } else {
+            sprintf(buffer, "%-16s %7lu %10lu %10lu %10lu %13lu\r\n",
+                    zone_names[i],
+                    (unsigned long)z->count,
+                    (unsigned long)z->min,
+                    (unsigned long)z->max,
+                    (unsigned long)(z->total / z->count),
+                    (unsigned long)(z->total / 1000));
+        }
+        uart_sendStr(buffer);
+    }
+
+    uart_sendStr("\r\n");
+}
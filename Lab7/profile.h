@@ -0,0 +1,57 @@
+/*
+ * profile.h
+ *
+ * Cycle-count profiling zones using the Cortex-M4 DWT cycle counter.
+ * Wrap code in profile_begin()/profile_end() and call profile_dump() to
+ * print count, min, max, average and total cycles for every zone over UART1.
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+
+/// Profiled zones, add new zones before PROFILE_NUM_ZONES and name them in profile.c
+typedef enum {
+    PROFILE_OI_UPDATE,
+    PROFILE_OI_PARSE_PACKET,
+    PROFILE_SCAN_ALL_ANGLES,
+    PROFILE_DETECT_OBJECTS,
+    PROFILE_UART_SEND_STR,
+    PROFILE_FMT_SPRINTF,
+    PROFILE_FMT_FIXED,
+    PROFILE_ODOMETRY_DOUBLE,
+    PROFILE_ODOMETRY_FLOAT,
+    PROFILE_NUM_ZONES
+} profile_zone_t;
+
+/// Statistics kept for each zone, all in CPU clock cycles
+typedef struct {
+    uint32_t count;  // Number of completed begin/end pairs
+    uint32_t min;    // Shortest run
+    uint32_t max;    // Longest run
+    uint64_t total;  // Sum of all runs
+    uint32_t start;  // Cycle count at the last profile_begin()
+} profile_stats_t;
+
+/// Enable the DWT cycle counter and clear all zone statistics
+void profile_init(void);
+
+/// Clear all zone statistics
+void profile_reset(void);
+
+/// Mark the start of a zone
+void profile_begin(profile_zone_t zone);
+
+/// Mark the end of a zone and record the cycles since profile_begin()
+void profile_end(profile_zone_t zone);
+
+/// Get the statistics recorded for one zone
+const profile_stats_t *profile_getStats(profile_zone_t zone);
+
+/// Send the statistics table for every zone over UART1
+void profile_dump(void);
+
+#endif /* PROFILE_H_ */
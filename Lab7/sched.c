@@ -0,0 +1,132 @@
+/*
+ * sched.c
+ *
+ * Rate-monotonic periodic task scheduler. Only the scheduling core lives
+ * here, it needs nothing but a clock so it builds on a host too; the timer
+ * clock, sleeping and the UART1 dump are in sched_port.c.
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stddef.h>
+#include "sched.h"
+
+static sched_task_t tasks[SCHED_MAX_TASKS];
+static int num_tasks = 0;
+
+static uint64_t (*sched_now)(void); // Set by sched_init() or sched_setClock()
+
+int sched_addTask(const char *name, void (*run)(void *arg), void *arg,
+                  uint32_t period_ms, uint8_t priority)
+{
+    int i = num_tasks;
+
+    if (num_tasks >= SCHED_MAX_TASKS || !run || period_ms == 0 || !sched_now) {
+        return -1;
+    }
+
+    tasks[i].name = name;
+    tasks[i].run = run;
+    tasks[i].arg = arg;
+    tasks[i].period = period_ms * 1000;
+    tasks[i].priority = priority;
+    tasks[i].next_release = sched_now() + tasks[i].period;
+    tasks[i].runs = 0;
+    tasks[i].misses = 0;
+    tasks[i].skipped = 0;
+    tasks[i].last_exec = 0;
+    tasks[i].wcet = 0;
+    num_tasks++;
+
+    return i;
+}
+
+int sched_runOnce(void)
+{
+    uint64_t now;
+    sched_task_t *t = NULL;
+    int i;
+
+    if (num_tasks == 0) {
+        return 0;
+    }
+    now = sched_now();
+
+    // Highest priority ready task, earliest release breaking ties
+    for (i = 0; i < num_tasks; i++) {
+        if (tasks[i].next_release > now) {
+            continue;
+        }
+        if (!t || tasks[i].priority < t->priority ||
+            (tasks[i].priority == t->priority && tasks[i].next_release < t->next_release)) {
+            t = &tasks[i];
+        }
+    }
+
+    if (!t) {
+        return 0;
+    }
+
+    uint64_t deadline = t->next_release + t->period;
+    uint64_t start = sched_now();
+    t->run(t->arg);
+    uint64_t end = sched_now();
+
+    t->runs++;
+    t->last_exec = (uint32_t)(end - start);
+    if (t->last_exec > t->wcet) {
+        t->wcet = t->last_exec;
+    }
+    if (end > deadline) {
+        t->misses++;
+    }
+
+    // Release the next job, dropping any releases the overrun covered
+    t->next_release = deadline;
+    if (t->next_release <= end) {
+        uint32_t behind = (uint32_t)((end - t->next_release) / t->period) + 1;
+        t->skipped += behind;
+        t->next_release += (uint64_t)behind * t->period;
+    }
+
+    return 1;
+}
+
+uint64_t sched_nextRelease(void)
+{
+    uint64_t next = UINT64_MAX;
+    int i;
+
+    for (i = 0; i < num_tasks; i++) {
+        if (tasks[i].next_release < next) {
+            next = tasks[i].next_release;
+        }
+    }
+
+    return next;
+}
+
+const sched_task_t *sched_getTask(int id)
+{
+    if (id < 0 || id >= num_tasks) {
+        return NULL;
+    }
+    return &tasks[id];
+}
+
+void sched_resetStats(void)
+{
+    int i;
+    for (i = 0; i < num_tasks; i++) {
+        tasks[i].runs = 0;
+        tasks[i].misses = 0;
+        tasks[i].skipped = 0;
+        tasks[i].last_exec = 0;
+        tasks[i].wcet = 0;
+    }
+}
+
+void sched_setClock(uint64_t (*now)(void))
+{
+    sched_now = now;
+}
@@ -0,0 +1,90 @@
+/*
+ * sched.h
+ *
+ * Rate-monotonic periodic task scheduler. Tasks register a period and a
+ * priority and run to completion from the main loop. Every task's deadline
+ * is the start of its next period; deadline misses, skipped releases and the
+ * worst-case execution time are recorded per task.
+ *
+ * Give shorter periods higher priority (lower number) for rate-monotonic
+ * ordering, e.g. odometry every 15ms at priority 0, ranging every 50ms at
+ * priority 1 and the UI every 200ms at priority 2.
+ *
+ * sched.c is the core and only needs a clock, set with sched_setClock(), so
+ * it can be tested on a host. sched_port.c adds the target clock, sleeping
+ * and sched_dump().
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS 8
+
+/// Statistics and timing for one periodic task, times in microseconds
+typedef struct {
+    const char *name;        // Name printed by sched_dump()
+    void (*run)(void *arg);  // Task body, must run to completion
+    void *arg;               // Passed to run
+    uint32_t period;         // Time between releases
+    uint8_t priority;        // 0 is the highest priority
+    uint64_t next_release;   // Time the next job becomes ready
+    uint32_t runs;           // Jobs completed
+    uint32_t misses;         // Jobs that finished after their deadline
+    uint32_t skipped;        // Releases dropped because a job overran
+    uint32_t last_exec;      // Execution time of the last job
+    uint32_t wcet;           // Worst-case execution time seen
+} sched_task_t;
+
+/// Use timer_getMicros64() as the scheduler clock, call after timer_init() and before sched_addTask()
+void sched_init(void);
+
+/**
+ * Register a periodic task. The first job is released one period from now.
+ * @param name Name printed by sched_dump()
+ * @param run Task body, called with arg
+ * @param arg Passed to run
+ * @param period_ms Time between releases in milliseconds
+ * @param priority 0 is the highest priority
+ * @return task id, or -1 if the task table is full or no clock is set
+ */
+int sched_addTask(const char *name, void (*run)(void *arg), void *arg,
+                  uint32_t period_ms, uint8_t priority);
+
+/**
+ * Run the highest priority task that is ready, if any. Never blocks.
+ * @return 1 if a task ran, 0 if nothing was ready
+ */
+int sched_runOnce(void);
+
+/**
+ * Run every ready task, sleeping until the next release whenever nothing is
+ * ready. Never returns.
+ */
+void sched_run(void);
+
+/**
+ * Get the time of the earliest pending release, in microseconds.
+ * @return earliest release time, or UINT64_MAX if no task is registered
+ */
+uint64_t sched_nextRelease(void);
+
+/// Get a task's statistics, or NULL for an invalid id
+const sched_task_t *sched_getTask(int id);
+
+/// Clear every task's statistics
+void sched_resetStats(void);
+
+/**
+ * Set the clock the scheduler reads, in microseconds. sched_init() sets
+ * timer_getMicros64(); a simulated clock lets the scheduler run on a host.
+ */
+void sched_setClock(uint64_t (*now)(void));
+
+/// Send the statistics table for every task over UART1
+void sched_dump(void);
+
+#endif /* SCHED_H_ */
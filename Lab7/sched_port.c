@@ -0,0 +1,58 @@
+/*
+ * sched_port.c
+ *
+ * Scheduler glue for the TM4C123: the WTIMER0 clock, sleeping between
+ * releases and the UART1 statistics dump
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stdio.h>
+#include "sched.h"
+#include "Timer.h"
+#include "clock.h"
+#include "uart.h"
+
+void sched_init(void)
+{
+    sched_setClock(timer_getMicros64);
+}
+
+void sched_run(void)
+{
+    uint64_t next;
+
+    while (1) {
+        if (!sched_runOnce()) {
+            next = sched_nextRelease();
+            if (next != UINT64_MAX) {
+                next *= CLOCK_TICKS_PER_MICRO;
+            }
+            timer_sleepUntil(next);
+        }
+    }
+}
+
+void sched_dump(void)
+{
+    const sched_task_t *t;
+    char buffer[100];
+    int i;
+
+    uart_sendStr("\r\nTask            Prio Period(us)   Runs Misses Skipped  Last(us)  WCET(us)\r\n");
+    uart_sendStr("-------------------------------------------------------------------------\r\n");
+
+    for (i = 0; (t = sched_getTask(i)) != NULL; i++) {
+        sprintf(buffer, "%-15s %4u %10lu %6lu %6lu %7lu %9lu %9lu\r\n",
+                t->name, t->priority,
+                (unsigned long)t->period,
+                (unsigned long)t->runs,
+                (unsigned long)t->misses,
+                (unsigned long)t->skipped,
+                (unsigned long)t->last_exec,
+                (unsigned long)t->wcet);
+        uart_sendStr(buffer);
+    }
+
+    uart_sendStr("\r\n");
+}
@@ -0,0 +1,272 @@
+/*
+ * telemetry.c
+ *
+ * Compact binary telemetry over UART1, see telemetry.h for the frame format
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include "telemetry.h"
+#include "Timer.h"
+#include "chan.h"
+
+#define TELEMETRY_HEADER_SIZE 6 // type, seq, u32 time
+#define TELEMETRY_SAMPLE_SIZE 6 // u8 angle, u24 IR and ping, u16 time offset
+#define TELEMETRY_BODY_SIZE (TELEMETRY_SCAN_BATCH * TELEMETRY_SAMPLE_SIZE)
+#define TELEMETRY_PAYLOAD_SIZE (TELEMETRY_HEADER_SIZE + TELEMETRY_BODY_SIZE + 2)
+
+#if TELEMETRY_LOG_SIZE > TELEMETRY_BODY_SIZE
+#error "TELEMETRY_LOG_SIZE must fit in a scan frame"
+#endif
+
+// COBS adds one byte per 254, plus the two 0x00 delimiters
+#define TELEMETRY_FRAME_SIZE (TELEMETRY_PAYLOAD_SIZE + TELEMETRY_PAYLOAD_SIZE / 254 + 1 + 2)
+
+#if TELEMETRY_FRAME_SIZE > CHAN_MAX_MESSAGE
+#error "A telemetry frame must fit in one channel message"
+#endif
+
+static int enabled = 0;
+static uint8_t seq = 0;
+static telemetry_stats_t stats;
+
+// Scan batch being filled by telemetry_scanSample()
+static uint8_t scan_payload[TELEMETRY_PAYLOAD_SIZE];
+static int scan_count = 0;
+static uint32_t scan_time;
+
+// oi_t odometer and heading at the last telemetry_resetOdometry(), taken
+// from the next odometry call after the reset
+static float odom_distance_base = 0; // mm
+static float odom_heading_base = 0;  // degrees
+static int odom_reset = 1;
+static uint32_t odom_last_sent = 0;
+
+// Frame being encoded, only touched from the main loop
+static uint8_t frame[TELEMETRY_FRAME_SIZE];
+
+// CRC-16/CCITT-FALSE, one byte at a time without a table
+static uint16_t crc16(const uint8_t *data, int len)
+{
+    uint16_t crc = 0xFFFF;
+    int i;
+    for (i = 0; i < len; i++) {
+        crc = (crc >> 8) | (crc << 8);
+        crc ^= data[i];
+        crc ^= (crc & 0xFF) >> 4;
+        crc ^= crc << 12;
+        crc ^= (crc & 0xFF) << 5;
+    }
+    return crc;
+}
+
+static void put16(uint8_t *p, uint32_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
+}
+
+// Clamp a float to 0..max and round it to the nearest integer
+static uint32_t to_unsigned(float value, uint32_t max)
+{
+    if (value <= 0) {
+        return 0;
+    }
+    if (value >= max) {
+        return max;
+    }
+    return (uint32_t)(value + 0.5f);
+}
+
+// Round a float to the nearest integer, either sign
+static int32_t to_signed(float value)
+{
+    return (int32_t)(value < 0 ? value - 0.5f : value + 0.5f);
+}
+
+// Fill in the type, sequence number and time at the start of a payload
+static void put_header(uint8_t *payload, telemetry_type_t type, uint32_t time)
+{
+    payload[0] = type;
+    payload[1] = seq++;
+    put32(payload + 2, time);
+}
+
+// Append the CRC, COBS encode the payload between two delimiters and queue it
+static void send_frame(uint8_t *payload, int len, chan_id_t chan)
+{
+    int out = 2;     // Next free byte, after the leading delimiter and first code
+    int code_at = 1; // Where the code byte of the current block goes
+    uint8_t code = 1;
+    int i;
+
+    put16(payload + len, crc16(payload, len));
+    len += 2;
+
+    frame[0] = 0;
+    for (i = 0; i < len; i++) {
+        if (payload[i] == 0) {
+            frame[code_at] = code;
+            code_at = out++;
+            code = 1;
+        }
+        else {
+            frame[out++] = payload[i];
+            code++;
+            if (code == 0xFF) {
+                frame[code_at] = code;
+                code_at = out++;
+                code = 1;
+            }
+        }
+    }
+    frame[code_at] = code;
+    frame[out++] = 0;
+
+    if (chan_write(chan, (const char *)frame, out) == 0) {
+        stats.dropped++;
+        return;
+    }
+    stats.frames++;
+    stats.bytes += out;
+}
+
+void telemetry_enable(int enable)
+{
+    if (enable && !enabled) {
+        stats.frames = 0;
+        stats.bytes = 0;
+        stats.samples = 0;
+        stats.dropped = 0;
+        scan_count = 0;
+    }
+    else if (!enable && enabled) {
+        telemetry_scanFlush();
+    }
+    enabled = enable;
+}
+
+int telemetry_enabled(void)
+{
+    return enabled;
+}
+
+void telemetry_scanSample(int angle, int ir_raw, float ping_cm)
+{
+    uint32_t now, ir, ping, offset;
+    uint8_t *sample;
+
+    if (!enabled) {
+        return;
+    }
+    now = timer_getMillis();
+    ir = ir_raw < 0 ? 0 : (ir_raw > 0xFFF ? 0xFFF : ir_raw);
+    ping = to_unsigned(ping_cm * 10.0f, TELEMETRY_PING_MAX_MM);
+
+    if (scan_count == 0) {
+        scan_time = now;
+        put_header(scan_payload, TELEMETRY_SCAN, now);
+    }
+    offset = now - scan_time;
+    if (offset > 0xFFFF) {
+        offset = 0xFFFF;
+    }
+
+    sample = scan_payload + TELEMETRY_HEADER_SIZE + scan_count * TELEMETRY_SAMPLE_SIZE;
+    sample[0] = angle < 0 ? 0 : (angle > 0xFF ? 0xFF : angle);
+    sample[1] = ir & 0xFF;
+    sample[2] = (ir >> 8) | ((ping & 0x0F) << 4);
+    sample[3] = ping >> 4;
+    put16(sample + 4, offset);
+    stats.samples++;
+
+    if (++scan_count == TELEMETRY_SCAN_BATCH) {
+        telemetry_scanFlush();
+    }
+}
+
+void telemetry_scanFlush(void)
+{
+    if (scan_count == 0) {
+        return;
+    }
+    send_frame(scan_payload, TELEMETRY_HEADER_SIZE + scan_count * TELEMETRY_SAMPLE_SIZE, CHAN_TELEMETRY);
+    scan_count = 0;
+}
+
+void telemetry_sendObject(int index, float start_angle, float end_angle,
+                          float distance_cm, float linear_width_cm)
+{
+    uint8_t payload[TELEMETRY_HEADER_SIZE + 9 + 2];
+
+    if (!enabled) {
+        return;
+    }
+
+    put_header(payload, TELEMETRY_OBJECT, timer_getMillis());
+    payload[6] = index;
+    put16(payload + 7, to_unsigned(start_angle * 10.0f, 0xFFFF));
+    put16(payload + 9, to_unsigned(end_angle * 10.0f, 0xFFFF));
+    put16(payload + 11, to_unsigned(distance_cm * 10.0f, 0xFFFF));
+    put16(payload + 13, to_unsigned(linear_width_cm * 10.0f, 0xFFFF));
+    send_frame(payload, TELEMETRY_HEADER_SIZE + 9, CHAN_TELEMETRY);
+}
+
+void telemetry_sendOdometry(const oi_t *sensor_data)
+{
+    uint8_t payload[TELEMETRY_HEADER_SIZE + 8 + 2];
+    uint32_t now;
+
+    if (odom_reset) {
+        odom_distance_base = sensor_data->odometer;
+        odom_heading_base = sensor_data->heading;
+        odom_reset = 0;
+    }
+
+    if (!enabled) {
+        return;
+    }
+    now = timer_getMillis();
+    if (now - odom_last_sent < TELEMETRY_ODOMETRY_PERIOD_MS) {
+        return;
+    }
+    odom_last_sent = now;
+
+    put_header(payload, TELEMETRY_ODOMETRY, now);
+    put32(payload + 6, (uint32_t)to_signed(sensor_data->odometer - odom_distance_base));
+    put32(payload + 10, (uint32_t)to_signed((sensor_data->heading - odom_heading_base) * 10.0f));
+    send_frame(payload, TELEMETRY_HEADER_SIZE + 8, CHAN_TELEMETRY);
+}
+
+void telemetry_sendLog(const uint8_t *records, int len)
+{
+    uint8_t payload[TELEMETRY_HEADER_SIZE + TELEMETRY_LOG_SIZE + 2];
+    int i;
+
+    if (len > TELEMETRY_LOG_SIZE) {
+        len = TELEMETRY_LOG_SIZE;
+    }
+    put_header(payload, TELEMETRY_LOG, timer_getMillis());
+    for (i = 0; i < len; i++) {
+        payload[TELEMETRY_HEADER_SIZE + i] = records[i];
+    }
+    send_frame(payload, TELEMETRY_HEADER_SIZE + len, CHAN_CONSOLE);
+}
+
+void telemetry_resetOdometry(void)
+{
+    odom_reset = 1;
+}
+
+void telemetry_getStats(telemetry_stats_t *stats_out)
+{
+    *stats_out = stats;
+}
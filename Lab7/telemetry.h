@@ -0,0 +1,94 @@
+/*
+ * telemetry.h
+ *
+ * Compact binary telemetry over UART1. Scan samples, detected objects and
+ * odometry are packed into little-endian records, protected with a CRC16
+ * and framed with COBS so every frame is delimited by 0x00 bytes. Text
+ * console output can be mixed in between frames, tools/telemetry_decode.py
+ * skips it and turns the frames back into CSV.
+ *
+ * Frame on the wire: 0x00, COBS(type, seq, body, crc16 low, crc16 high), 0x00
+ * crc16 is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over type..body.
+ *
+ * Bodies, all little-endian:
+ *   TELEMETRY_SCAN      u32 time ms, then up to TELEMETRY_SCAN_BATCH samples of
+ *                       u8 angle deg, u24 (IR raw bits 0-11, ping mm bits 12-23),
+ *                       u16 ms since the frame time
+ *   TELEMETRY_OBJECT    u32 time ms, u8 index, u16 start and u16 end angle in
+ *                       0.1 deg, u16 distance mm, u16 linear width mm
+ *   TELEMETRY_ODOMETRY  u32 time ms, i32 distance mm, i32 heading in 0.1 deg,
+ *                       both totals since telemetry_resetOdometry()
+ *   TELEMETRY_LOG       u32 time ms, then whole log records, see log.h
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+#include "open_interface.h"
+
+/// Record types, first byte of every frame
+typedef enum {
+    TELEMETRY_SCAN = 1,
+    TELEMETRY_OBJECT = 2,
+    TELEMETRY_ODOMETRY = 3,
+    TELEMETRY_LOG = 4
+} telemetry_type_t;
+
+/// Scan samples packed into one frame before it is sent
+#define TELEMETRY_SCAN_BATCH 16
+
+/// Shortest time between two odometry frames
+#define TELEMETRY_ODOMETRY_PERIOD_MS 50
+
+/// Most bytes of log records in one TELEMETRY_LOG frame
+#define TELEMETRY_LOG_SIZE 96
+
+/// Largest ping distance a scan sample can carry, farther readings are clamped
+#define TELEMETRY_PING_MAX_MM 4095
+
+/// Counters since the last telemetry_enable(1)
+typedef struct {
+    uint32_t frames;  // Frames queued on their channel, see chan.h
+    uint32_t bytes;   // Bytes in those frames, including delimiters
+    uint32_t samples; // Scan samples sent
+    uint32_t dropped; // Frames dropped because the telemetry channel was full
+} telemetry_stats_t;
+
+/// Turn binary telemetry on (1) or off (0). Turning it on clears the counters,
+/// turning it off sends any scan samples still waiting in the batch.
+void telemetry_enable(int enable);
+
+/// Returns 1 while binary telemetry is on
+int telemetry_enabled(void);
+
+/// Add one scan sample to the current batch, the batch goes out once it
+/// holds TELEMETRY_SCAN_BATCH samples
+void telemetry_scanSample(int angle, int ir_raw, float ping_cm);
+
+/// Send the scan samples waiting in the batch, call at the end of a scan
+void telemetry_scanFlush(void);
+
+/// Send one detected object
+void telemetry_sendObject(int index, float start_angle, float end_angle,
+                          float distance_cm, float linear_width_cm);
+
+/// Send the oi_t odometer and heading, relative to the last reset, if
+/// TELEMETRY_ODOMETRY_PERIOD_MS has passed. Does nothing while binary
+/// telemetry is off, so movement loops can call it after every oi_update()
+void telemetry_sendOdometry(const oi_t *sensor_data);
+
+/// Send len bytes of log records in one frame. Unlike the other records
+/// these go out whether or not binary telemetry is on, and on CHAN_CONSOLE
+/// so they are never dropped.
+void telemetry_sendLog(const uint8_t *records, int len);
+
+/// Zero the odometry totals
+void telemetry_resetOdometry(void);
+
+/// Copy the frame counters
+void telemetry_getStats(telemetry_stats_t *stats);
+
+#endif /* TELEMETRY_H_ */
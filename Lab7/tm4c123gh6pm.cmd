@@ -31,6 +31,7 @@ SECTIONS
     .intvecs:   > 0x00000000
     .text   :   > FLASH
     .const  :   > FLASH
+    .logfmt :   > FLASH, LOAD_START(__logfmt_start) /* LOG_*() format strings, see log.h */
     .cinit  :   > FLASH
     .pinit  :   > FLASH
     .init_array : > FLASH
@@ -38,6 +39,7 @@ SECTIONS
     .vtable :   > 0x20000000
     .data   :   > SRAM
     .bss    :   > SRAM
+    .TI.noinit : > SRAM
     .sysmem :   > SRAM
     .stack  :   > SRAM
 }
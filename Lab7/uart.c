@@ -1,9 +1,14 @@
 /*
 *   uart-interrupt.c
 *
-*   Minimal example matching the lab template, for UART1 interrupts at 115200 baud,
-*   8 data bits, no parity, 1 stop bit, no FIFO.  The interrupt handler echoes
-*   each received character.  No calls to uart_receive() in the main program.
+*   UART1 at 115200 baud, 8 data bits, no parity, 1 stop bit, FIFOs enabled.
+*   uart_setBaud() switches to faster rates at runtime.
+*   Transmits are queued in a ring buffer that the TX interrupt drains, so
+*   sending never waits on the line unless the buffer fills up under
+*   UART_TX_BLOCK.  Received bytes are queued in a second ring buffer by the
+*   interrupt handler and read back with uart_receive(),
+*   uart_receive_nonblocking() or the uart_getLine() line assembler.  Large
+*   buffers can go out through the uDMA with uart_sendDma().
 *
 *   @author
 *   @date
@@ -12,12 +17,49 @@
 #include <inc/tm4c123gh6pm.h>
 #include <stdint.h>
 #include <uart.h>
+#include "clock.h"
+#include "isrstat.h"
+#include "profile.h"
+#include "Timer.h"
+#include "udma.h"
+#include "driverlib/cpu.h" // for CPUcpsid, CPUcpsie, CPUprimask
 #include "driverlib/interrupt.h" // for IntRegister, IntMasterEnable
 
 // Example global variables you can use if implementing a special command:
 volatile char command_byte = -1;   // e.g. 's' for stop
 volatile int  command_flag = 0;    // set to 1 in ISR if command_byte received
 
+// Bytes received by UART1_Handler and not read yet, indexed like tx_buffer
+static char rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile uint32_t rx_head = 0; // Next free slot, advanced by UART1_Handler
+static volatile uint32_t rx_tail = 0; // Next byte to read, advanced by readers
+static uart_rx_stats_t rx_stats;
+
+// Line being assembled by uart_getLine()
+static char line_buffer[UART_LINE_SIZE];
+static int line_length = 0;
+static int line_echo = 1;
+
+// Bytes waiting for the TX FIFO. Indices run freely and are masked on use,
+// so head - tail is the occupancy even when they wrap.
+static char tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile uint32_t tx_head = 0; // Next free slot, advanced by senders
+static volatile uint32_t tx_tail = 0; // Next byte for the FIFO, advanced by uart_txFill()
+static uint32_t baud_rate = UART_BAUD_DEFAULT;
+static uart_tx_policy_t tx_policy = UART_TX_BLOCK;
+static void (*tx_refill)(void);        // Called from UART1_Handler for more to send
+static uart_tx_stats_t tx_stats;
+
+// Transfer handed to uart_sendDma(). It waits until the ring bytes queued
+// before it are in the FIFO, then blocks the ring until the uDMA finishes.
+typedef enum { DMA_IDLE, DMA_PENDING, DMA_ACTIVE } uart_dma_state_t;
+static volatile uart_dma_state_t dma_state = DMA_IDLE;
+static const char *dma_next;    // Start of the next chunk for the uDMA
+static uint32_t dma_left;       // Bytes not handed to the uDMA yet
+static uint32_t dma_mark;       // tx_head when the transfer was queued
+static void (*dma_done)(void);  // Called once the last byte is in the FIFO
+static int dma_ready = 0;       // udma_init() has been called
+
 void uart_interrupt_init(void){
     //enable clock to GPIO port B
     SYSCTL_RCGCGPIO_R |= 0x02;  // enable clock to Port B (bit 1) page 340
@@ -39,10 +81,10 @@ void uart_interrupt_init(void){
     // for PB0=Rx, PB1=Tx => bits [3:0] and [7:4] = 1 => 0x11
     GPIO_PORTB_PCTL_R |= 0x00000011;
 
-    //calculate baud rate
+    //calculate baud rate from the system clock
     // With 16 MHz clock:  Baud = 115,200 => IBRD=8, FBRD=44
-    uint16_t iBRD = 8;
-    uint16_t fBRD = 44;
+    uint16_t iBRD = CLOCK_UART_IBRD(UART_BAUD_DEFAULT);
+    uint16_t fBRD = CLOCK_UART_FBRD(UART_BAUD_DEFAULT);
 
     //turn off UART1 while setting it up
     UART1_CTL_R &= ~0x01;  //disable bit0 = UARTEN
@@ -51,8 +93,12 @@ void uart_interrupt_init(void){
     UART1_IBRD_R = iBRD;
     UART1_FBRD_R = fBRD;
 
-    //set frame, 8 data bits, 1 stop bit, no parity, no FIFO => 0x60
-    UART1_LCRH_R |= 0x60; // write serial communication parameters, page 916, * 8bit and no parity
+    //set frame, 8 data bits, 1 stop bit, no parity, FIFOs on => 0x70
+    UART1_LCRH_R |= 0x70; // write serial communication parameters, page 916, * 8bit and no parity
+
+    //interrupt when the TX FIFO drains to 2 bytes and the RX FIFO holds 2 bytes;
+    //the receive timeout interrupt picks up a lone byte
+    UART1_IFLS_R = UART_IFLS_TX1_8 | UART_IFLS_RX1_8;
 
     //use system clock as source
     UART1_CC_R = 0x0;  // use system clock as clock source (page 939)
@@ -68,6 +114,9 @@ void uart_interrupt_init(void){
     // when its 1, An interrupt is sent to the interrupt controller when the RXRIS
     // bit in the UARTRIS register is set.
 
+    //enable the RX timeout (bit6) and TX (bit5) interrupts for the FIFOs
+    UART1_IM_R |= UART_IM_RTIM | UART_IM_TXIM;
+
 
     //NVIC setup: set priority of UART1 interrupt to 1 in bits 21-23 of PRI1 (page 153)
     // PRI1 is a 32 bit register, and bits [23:21] control interrupt#6s priority which is uart1
@@ -103,54 +152,423 @@ void uart_interrupt_init(void){
      */
 }
 
-// For Lab 6, we typically do not call uart_receive(), so it can be left empty or commented out.
-// "DO NOT USE this busy-wait function if using RX interrupt"
+int uart_rxReady(void) {
+    return rx_head != rx_tail;
+}
+
+// Wait for UART1_Handler to queue a byte instead of polling the data
+// register. The CPU sleeps while waiting.
 char uart_receive(void) {
-    // Wait while RXFE (bit 4) is set => FIFO is empty
-    while (UART1_FR_R & 0x10) {}
-    return (char) (UART1_DR_R & 0xFF);
+    while (!uart_rxReady()) {
+        timer_idleUntil(UINT64_MAX, uart_rxReady);
+    }
+    return uart_receive_nonblocking();
+}
+
+char uart_receive_nonblocking(void) {
+    char data;
+
+    if (!uart_rxReady()) {
+        return 0;
+    }
+
+    // Only readers move the tail, so no lock is needed
+    data = rx_buffer[rx_tail & (UART_RX_BUFFER_SIZE - 1)];
+    rx_tail++;
+
+    return data;
+}
+
+int uart_getLine(char *line, int size) {
+    char data;
+    int length;
+    int i;
+
+    while (uart_rxReady()) {
+        data = uart_receive_nonblocking();
+
+        if (data == '\r' || data == '\n') {
+            if (line_length == 0) {
+                continue; // Skip the \n of a \r\n pair and empty lines
+            }
+            if (line_echo) {
+                uart_sendStr("\r\n");
+            }
+
+            length = line_length < size - 1 ? line_length : size - 1;
+            for (i = 0; i < length; i++) {
+                line[i] = line_buffer[i];
+            }
+            line[length] = '\0';
+            line_length = 0;
+            return length;
+        }
+        else if (data == '\b' || data == 0x7F) {
+            // Backspace or delete, erase the last character
+            if (line_length > 0) {
+                line_length--;
+                if (line_echo) {
+                    uart_sendStr("\b \b");
+                }
+            }
+        }
+        else if (line_length < UART_LINE_SIZE - 1) {
+            line_buffer[line_length++] = data;
+            if (line_echo) {
+                uart_sendChar(data);
+            }
+        }
+    }
+
+    return -1;
+}
+
+void uart_setEcho(int echo) {
+    line_echo = echo;
+}
+
+void uart_getRxStats(uart_rx_stats_t *stats) {
+    uint32_t was_masked = CPUcpsid();
+    *stats = rx_stats;
+    if (!was_masked) {
+        CPUcpsie();
+    }
+}
+
+// Keep UART1_Handler and any other sender out of the TX ring while it is
+// updated. Senders can run in ISRs too, so masking UART1 alone isn't enough.
+static uint32_t uart_lock(void) {
+    return CPUcpsid();
+}
+
+static void uart_unlock(uint32_t was_masked) {
+    if (!was_masked) {
+        CPUcpsie();
+    }
+}
+
+// Hand the next chunk of a uart_sendDma() transfer to the uDMA
+static void uart_dmaNext(void) {
+    uint32_t count = dma_left < UDMA_MAX_TRANSFER ? dma_left : UDMA_MAX_TRANSFER;
+
+    udma_sendBytes(UDMA_CH_UART1_TX, dma_next, &UART1_DR_R, count);
+    dma_next += count;
+    dma_left -= count;
+}
+
+static void uart_txFill(void);
+
+// Start the next chunk or finish the transfer once the uDMA has moved the
+// last byte of a chunk into the TX FIFO. Called from UART1_Handler, and by
+// the polling waits, which the handler can't interrupt.
+static void uart_dmaService(void) {
+    if (dma_state != DMA_ACTIVE || !udma_takeDone(UDMA_CH_UART1_TX)) {
+        return;
+    }
+
+    if (dma_left) {
+        uart_dmaNext();
+    }
+    else {
+        void (*done)(void) = dma_done;
+
+        UART1_DMACTL_R &= ~UART_DMACTL_TXDMAE;
+        dma_state = DMA_IDLE;
+        uart_txFill(); // Resume anything queued behind the transfer
+        if (done) {
+            done();
+        }
+        if (tx_refill) {
+            tx_refill();
+        }
+    }
+}
+
+// Move bytes from the ring into the TX FIFO until one of them runs out.
+// Caller holds uart_lock() or is UART1_Handler.
+static void uart_txFill(void) {
+    uint32_t end = (dma_state == DMA_PENDING) ? dma_mark : tx_head;
+
+    if (dma_state == DMA_ACTIVE) {
+        return; // The uDMA owns the FIFO until it finishes
+    }
+
+    while (tx_tail != end && !(UART1_FR_R & UART_FR_TXFF)) {
+        UART1_DR_R = tx_buffer[tx_tail & (UART_TX_BUFFER_SIZE - 1)];
+        tx_tail++;
+    }
+
+    if (dma_state == DMA_PENDING && tx_tail == dma_mark) {
+        dma_state = DMA_ACTIVE;
+        UART1_DMACTL_R |= UART_DMACTL_TXDMAE; // Let the TX FIFO request uDMA bursts
+        uart_dmaNext();
+    }
+}
+
+static uint32_t uart_txSpace(void) {
+    return UART_TX_BUFFER_SIZE - (tx_head - tx_tail);
+}
+
+static int uart_txHasSpace(void) {
+    return uart_txSpace() != 0;
+}
+
+static int uart_txEmpty(void) {
+    return tx_head == tx_tail && dma_state == DMA_IDLE;
+}
+
+static int uart_dmaIdle(void) {
+    return dma_state == DMA_IDLE;
+}
+
+void uart_setTxPolicy(uart_tx_policy_t policy) {
+    tx_policy = policy;
+}
+
+int uart_sendBuf(const char *data, int len) {
+    uart_tx_policy_t policy = tx_policy;
+    uint32_t was_masked;
+    uint32_t used;
+    int sent = 0;
+
+    // An ISR can't wait for the TX interrupt
+    if (policy == UART_TX_BLOCK && (NVIC_INT_CTRL_R & NVIC_INT_CTRL_VEC_ACT_M)) {
+        policy = UART_TX_TRUNCATE;
+    }
+
+    was_masked = uart_lock();
+
+    if (policy == UART_TX_DROP && uart_txSpace() < (uint32_t)len) {
+        tx_stats.dropped += len;
+        uart_unlock(was_masked);
+        return 0;
+    }
+
+    while (sent < len) {
+        if (uart_txSpace() == 0) {
+            if (policy != UART_TX_BLOCK) {
+                break;
+            }
+
+            // Buffer full, wait for the TX interrupt to make room
+            uart_txFill();
+            if (was_masked) {
+                // Nothing drains the ring while interrupts are off, so poll,
+                // finishing a uDMA transfer ourselves since it holds the FIFO
+                while (!uart_txHasSpace()) {
+                    uart_dmaService();
+                    uart_txFill();
+                }
+            }
+            else {
+                uart_unlock(was_masked);
+                timer_idleUntil(UINT64_MAX, uart_txHasSpace);
+                was_masked = uart_lock();
+            }
+            continue;
+        }
+
+        tx_buffer[tx_head & (UART_TX_BUFFER_SIZE - 1)] = data[sent++];
+        tx_head++;
+
+        used = tx_head - tx_tail;
+        if (used > tx_stats.peak) {
+            tx_stats.peak = used;
+        }
+    }
+
+    tx_stats.queued += sent;
+    tx_stats.dropped += len - sent;
+
+    // The TX interrupt only fires as the FIFO drains, so start it off here
+    uart_txFill();
+    uart_unlock(was_masked);
+
+    return sent;
+}
+
+int uart_sendDma(const char *data, int len, void (*done)(void)) {
+    uint32_t was_masked;
+
+    if (len <= 0) {
+        return -1;
+    }
+    if (!dma_ready) {
+        udma_init();
+        dma_ready = 1;
+    }
+
+    was_masked = uart_lock();
+    if (dma_state != DMA_IDLE) {
+        uart_unlock(was_masked);
+        return -1;
+    }
+
+    dma_next = data;
+    dma_left = len;
+    dma_done = done;
+    dma_mark = tx_head;
+    dma_state = DMA_PENDING;
+    uart_txFill(); // Starts right away if nothing is queued ahead of it
+
+    uart_unlock(was_masked);
+    return 0;
+}
+
+int uart_dmaBusy(void) {
+    return !uart_dmaIdle();
+}
+
+void uart_dmaWait(void) {
+    while (!uart_dmaIdle()) {
+        timer_idleUntil(UINT64_MAX, uart_dmaIdle);
+    }
+}
+
+void uart_txFlush(void) {
+    while (!uart_txEmpty()) {
+        if (CPUprimask() || (NVIC_INT_CTRL_R & NVIC_INT_CTRL_VEC_ACT_M)) {
+            // Interrupts can't drain the ring or finish a uDMA transfer here, so poll
+            uart_dmaService();
+            uart_txFill();
+        }
+        else {
+            timer_idleUntil(UINT64_MAX, uart_txEmpty);
+        }
+    }
+    while (UART1_FR_R & UART_FR_BUSY) {} // Last bytes leaving the shift register
+}
+
+// Divisor for baud in 1/64ths, or 0 if it's faster than the 16x oversampling allows
+static uint32_t uart_baudDiv64(uint32_t baud) {
+    if (baud == 0 || baud > SYSCLK_HZ / 16) {
+        return 0;
+    }
+    return CLOCK_UART_DIV64(baud);
+}
+
+int32_t uart_baudError(uint32_t baud) {
+    uint32_t div64 = uart_baudDiv64(baud);
+    if (div64 == 0) {
+        return INT32_MAX;
+    }
+    // The UART really runs at SYSCLK * 4 / div64
+    return (int32_t)(((int64_t)SYSCLK_HZ * 4 * 10000 / div64 - (int64_t)baud * 10000) / baud);
+}
+
+int uart_setBaud(uint32_t baud) {
+    uint32_t div64 = uart_baudDiv64(baud);
+    int32_t error = uart_baudError(baud);
+
+    if (div64 == 0 || error > UART_BAUD_MAX_ERROR || error < -UART_BAUD_MAX_ERROR) {
+        return -1;
+    }
+
+    // Changing the rate mid-byte would garble it
+    uart_txFlush();
+
+    UART1_CTL_R &= ~UART_CTL_UARTEN;
+    UART1_IBRD_R = div64 >> 6;
+    UART1_FBRD_R = div64 & 0x3F;
+    UART1_LCRH_R = UART1_LCRH_R; // New divisors only take effect on an LCRH write
+    UART1_CTL_R |= UART_CTL_UARTEN;
+    baud_rate = baud;
+    return 0;
+}
+
+uint32_t uart_getBaud(void) {
+    return baud_rate;
+}
+
+uint32_t uart_txPending(void) {
+    return tx_head - tx_tail;
+}
+
+void uart_setTxRefill(void (*refill)(void)) {
+    tx_refill = refill;
+}
+
+void uart_getTxStats(uart_tx_stats_t *stats) {
+    uint32_t was_masked = uart_lock();
+    *stats = tx_stats;
+    uart_unlock(was_masked);
+}
+
+void uart_resetTxStats(void) {
+    uint32_t was_masked = uart_lock();
+    tx_stats.queued = 0;
+    tx_stats.dropped = 0;
+    tx_stats.peak = tx_head - tx_tail;
+    uart_unlock(was_masked);
 }
 
 void uart_sendChar(char data){
-    // wait while TXFF (bit5)
-    while(UART1_FR_R & 0x20){}
-    UART1_DR_R = data;
+    uart_sendBuf(&data, 1);
 }
 
 void uart_sendStr(const char *data){
-    int i=0;
-    while(data[i] != '\0'){
-        uart_sendChar(data[i]);
-        i++;
+    profile_begin(PROFILE_UART_SEND_STR);
+    int len = 0;
+    while(data[len] != '\0'){
+        len++;
     }
+    uart_sendBuf(data, len);
+    profile_end(PROFILE_UART_SEND_STR);
 }
 
 void UART1_Handler(void)
 {
     char byte_received;
-    //check if handler called due to RX event => bit4 in MIS
-    if (UART1_MIS_R & 0x10)  // bit 4 indicates rx interrupt
+    uint32_t entry = isrstat_enter(ISRSTAT_UART1, ISRSTAT_NO_LATENCY);
+
+    //uDMA moved the last byte of a chunk into the TX FIFO
+    uart_dmaService();
+
+    //TX FIFO drained to its trigger level, refill it from the ring
+    if (UART1_MIS_R & UART_MIS_TXMIS)
+    {
+        UART1_ICR_R = UART_ICR_TXIC;
+        uart_txFill();
+        if (tx_refill) {
+            tx_refill();
+        }
+    }
+
+    //check if handler called due to RX event => bit4 in MIS, or RX timeout => bit6
+    if (UART1_MIS_R & (UART_MIS_RXMIS | UART_MIS_RTMIS))
     {
-        //clear the RX trigger flag => write 1 to bit4 in ICR
+        //clear the RX trigger flags => write 1 to bit4 and bit6 in ICR
         // tells the hardware we are handling the interrupt so we can clear the flax
-        UART1_ICR_R |= 0x10;
+        UART1_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC;
+    }
 
-        //read the byte from UART1_DR_R (ignore error bits)
-        //read the character from the data register, mask the lower 8 bits so we can ignore the error/status bits
-        byte_received = (char)(UART1_DR_R & 0xFF);  // (????? ->  (char)(UART1_DR_R & 0xFF) )
+    //empty the RX FIFO into the ring buffer, echoing is left to uart_getLine()
+    while (!(UART1_FR_R & UART_FR_RXFE))
+    {
+        //read the character from the data register, the upper bits are error flags
+        uint32_t data = UART1_DR_R;
+        byte_received = (char)(data & 0xFF);
 
-        //echo it back
-        uart_sendChar(byte_received);
+        rx_stats.received++;
+        if (data & UART_DR_OE) {
+            rx_stats.hw_overruns++; // FIFO was full, a byte before this one was lost
+        }
+        if (data & (UART_DR_FE | UART_DR_PE | UART_DR_BE)) {
+            rx_stats.errors++;
+        }
 
-        //if byte is carriage return => also send newline
-        if (byte_received == '\r'){
-            uart_sendChar('\n');
+        if (rx_head - rx_tail < UART_RX_BUFFER_SIZE) {
+            rx_buffer[rx_head & (UART_RX_BUFFER_SIZE - 1)] = byte_received;
+            rx_head++;
         }
         else {
-            // As needed: handle special commands
-            if (byte_received == command_byte){
-                command_flag = 1; // let main know
-            }
+            rx_stats.overruns++; // Nobody is reading, drop the byte
+        }
+
+        // As needed: handle special commands
+        if (byte_received == command_byte){
+            command_flag = 1; // let main know
         }
     }
+    isrstat_exit(ISRSTAT_UART1, entry);
 }
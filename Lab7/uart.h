@@ -6,7 +6,7 @@
 *   Uses RX interrupt
 *   Functions for communicating between CyBot and PC via UART1
 *   Serial parameters: Baud = 115200, 8 data bits, 1 stop bit,
-*   no parity, no flow control on COM1, FIFOs disabled on UART1
+*   no parity, no flow control on COM1, FIFOs enabled on UART1
 *
 *   @author Dane Larson
 *   @date 07/18/2016
@@ -35,19 +35,126 @@ extern volatile int command_flag; // flag to tell the main program a special com
 // UART1 device initialization for CyBot to PuTTY
 void uart_interrupt_init(void);
 
+// Baud rate uart_interrupt_init() starts at
+#define UART_BAUD_DEFAULT 115200
+
+// Largest divisor error uart_setBaud() accepts, in hundredths of a percent
+#define UART_BAUD_MAX_ERROR 200
+
+// Difference between baud and the rate its IBRD/FBRD divisors really give
+// at SYSCLK_HZ, in hundredths of a percent, positive when the UART runs fast
+// Returns INT32_MAX if the UART can't reach baud at all
+int32_t uart_baudError(uint32_t baud);
+
+// Switch UART1 to a new baud rate once everything queued has gone out
+// Returns 0, or -1 if the error is over UART_BAUD_MAX_ERROR, leaving the rate unchanged
+int uart_setBaud(uint32_t baud);
+
+// Current baud rate
+uint32_t uart_getBaud(void);
+
+// Size of the TX ring buffer drained by the TX interrupt, must be a power of 2
+#define UART_TX_BUFFER_SIZE 512
+
+// What uart_sendBuf() does when the TX ring buffer is full
+typedef enum {
+    UART_TX_BLOCK,    // Wait for room, sleeping until the TX interrupt makes some
+    UART_TX_DROP,     // Drop the whole message if it doesn't fit
+    UART_TX_TRUNCATE  // Queue what fits and drop the rest
+} uart_tx_policy_t;
+
+// TX ring buffer counters, in bytes
+typedef struct {
+    uint32_t queued;  // Accepted into the ring buffer
+    uint32_t dropped; // Thrown away because the ring buffer was full
+    uint32_t peak;    // Highest ring buffer occupancy
+} uart_tx_stats_t;
+
 // Send a byte over UART1 from CyBot to PuTTY
 void uart_sendChar(char data);
 
+// Queue len bytes for UART1, following the full buffer policy
+// Returns the number of bytes queued
+// Called from an ISR, UART_TX_BLOCK acts like UART_TX_TRUNCATE
+int uart_sendBuf(const char *data, int len);
+
+// Send a buffer through the uDMA without the CPU copying it. The transfer
+// goes out after anything already queued, and later sends wait behind it.
+// The buffer must stay untouched until done is called from UART1_Handler
+// once the last byte is in the TX FIFO; done may be NULL.
+// Returns 0 if the transfer was queued, -1 if another one is still running
+int uart_sendDma(const char *data, int len, void (*done)(void));
+
+// Returns 1 while a uart_sendDma() transfer is queued or running
+int uart_dmaBusy(void);
+
+// Sleep until the uart_sendDma() transfer finishes
+void uart_dmaWait(void);
+
+// Choose what happens when the TX ring buffer is full, UART_TX_BLOCK by default
+void uart_setTxPolicy(uart_tx_policy_t policy);
+
+// Wait until every queued byte has left UART1
+void uart_txFlush(void);
+
+// Bytes in the TX ring that haven't reached the FIFO yet
+uint32_t uart_txPending(void);
+
+// Called from UART1_Handler each time the TX FIFO drains to its trigger
+// level or a uDMA transfer finishes, after the ring has refilled the FIFO.
+// Lets a layer above the driver feed the ring a little at a time, see chan.h.
+// NULL to remove.
+void uart_setTxRefill(void (*refill)(void));
+
+// Copy the TX ring buffer counters
+void uart_getTxStats(uart_tx_stats_t *stats);
+
+// Clear the TX counters, peak restarts from the current occupancy
+void uart_resetTxStats(void);
+
+// Size of the RX ring buffer filled by the RX interrupt, must be a power of 2
+#define UART_RX_BUFFER_SIZE 128
+
+// Longest line uart_getLine() assembles, including the terminating 0
+#define UART_LINE_SIZE 64
+
+// RX ring buffer counters
+typedef struct {
+    uint32_t received;    // Bytes read out of the RX FIFO
+    uint32_t overruns;    // Bytes dropped because the ring buffer was full
+    uint32_t hw_overruns; // Times the RX FIFO overflowed before the interrupt emptied it
+    uint32_t errors;      // Bytes with a framing, parity or break error
+} uart_rx_stats_t;
+
 // CyBot waits (i.e. blocks) to receive a byte from PuTTY
 // returns byte that was received by UART1
-// Not used with interrupts; see UART1_Handler
+// Sleeps until UART1_Handler queues the next byte
 char uart_receive(void);
 
+// Returns the next received byte, or 0 right away if there isn't one
+char uart_receive_nonblocking(void);
+
+// Returns 1 if uart_receive() has a byte ready and won't block
+int uart_rxReady(void);
+
+// Non-blocking line assembler. Consumes the bytes received so far and, once
+// a line ends with \r or \n, copies it into line without the line ending.
+// Handles backspace, skips empty lines and echoes what is typed unless
+// uart_setEcho(0) was called.
+// Returns the line length, or -1 if no complete line is ready yet
+int uart_getLine(char *line, int size);
+
+// Turn echoing of typed characters in uart_getLine() on (1) or off (0)
+void uart_setEcho(int echo);
+
+// Copy the RX ring buffer counters
+void uart_getRxStats(uart_rx_stats_t *stats);
+
 // Send a string over UART1
-// Sends each char in the string one at a time
+// Queues the string and returns without waiting for it to go out
 void uart_sendStr(const char *data);
 
-// Interrupt handler for receive interrupts
+// Interrupt handler for receive and transmit interrupts
 void UART1_Handler(void);
 
 #endif /* UART_H_ */
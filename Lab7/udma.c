@@ -0,0 +1,72 @@
+/*
+ * udma.c
+ *
+ * Micro DMA controller setup and basic memory to peripheral transfers
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <inc/tm4c123gh6pm.h>
+#include "udma.h"
+
+/// One channel control structure, the layout the controller reads from memory
+typedef struct {
+    volatile const void *src_end; // Address of the last source item
+    volatile void *dst_end;       // Address of the last destination item
+    volatile uint32_t control;    // Sizes, increments, count and mode
+    uint32_t unused;
+} udma_control_t;
+
+// Primary control structures for all 32 channels. The controller requires
+// the table to be aligned to 1024 bytes.
+#if defined(__TI_COMPILER_VERSION__)
+#pragma DATA_ALIGN(control_table, 1024)
+static udma_control_t control_table[32];
+#else
+static udma_control_t control_table[32] __attribute__((aligned(1024)));
+#endif
+
+void udma_init(void)
+{
+    SYSCTL_RCGCDMA_R |= SYSCTL_RCGCDMA_R0; // Turn on clock to the uDMA
+    while ((SYSCTL_PRDMA_R & SYSCTL_PRDMA_R0) == 0) {};
+
+    UDMA_CFG_R = UDMA_CFG_MASTEN;                 // Enable the controller
+    UDMA_CTLBASE_R = (uint32_t)control_table;     // Control table location
+    UDMA_CHMAP2_R &= ~UDMA_CHMAP2_CH23SEL_M;      // Channel 23 encoding 0, UART1 TX
+}
+
+void udma_sendBytes(int channel, const void *src, volatile uint32_t *dst, uint32_t count)
+{
+    uint32_t bit = 1UL << channel;
+    udma_control_t *c = &control_table[channel];
+
+    UDMA_ENACLR_R = bit;       // Stop the channel while it is set up
+    UDMA_ALTCLR_R = bit;       // Use the primary control structure
+    UDMA_PRIOCLR_R = bit;      // Default priority
+    UDMA_USEBURSTCLR_R = bit;  // Respond to single and burst requests
+    UDMA_REQMASKCLR_R = bit;   // Let the peripheral request transfers
+
+    c->src_end = (const uint8_t *)src + count - 1;
+    c->dst_end = dst;
+    c->control = UDMA_CHCTL_DSTINC_NONE     // Always write the data register
+               | UDMA_CHCTL_DSTSIZE_8
+               | UDMA_CHCTL_SRCINC_8        // Walk through the buffer a byte at a time
+               | UDMA_CHCTL_SRCSIZE_8
+               | UDMA_CHCTL_ARBSIZE_4       // Matches the UART burst request
+               | ((count - 1) << UDMA_CHCTL_XFERSIZE_S)
+               | UDMA_CHCTL_XFERMODE_BASIC;
+
+    UDMA_ENASET_R = bit;       // Start, the peripheral paces the transfer
+}
+
+int udma_takeDone(int channel)
+{
+    uint32_t bit = 1UL << channel;
+
+    if (UDMA_CHIS_R & bit) {
+        UDMA_CHIS_R = bit; // Write 1 to clear
+        return 1;
+    }
+    return 0;
+}
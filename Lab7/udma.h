@@ -0,0 +1,43 @@
+/*
+ * udma.h
+ *
+ * Micro DMA controller setup and basic memory to peripheral transfers. Only
+ * the primary control structures are used, so each channel runs one basic
+ * transfer of up to UDMA_MAX_TRANSFER items at a time. Completion is
+ * signalled on the interrupt vector of the peripheral that owns the channel.
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef UDMA_H_
+#define UDMA_H_
+
+#include <stdint.h>
+
+#define UDMA_MAX_TRANSFER 1024 // Most items one basic transfer can move
+
+// Channels in use, all with encoding 0, which udma_init() selects. Channel 9
+// is UART1 TX only with encoding 1, with encoding 0 it is UART0 TX.
+#define UDMA_CH_UART1_TX 23
+
+/// Turn on the uDMA controller and point it at the control table
+void udma_init(void);
+
+/**
+ * Start a basic transfer of bytes from memory into a peripheral FIFO
+ * register, one request per UART burst.
+ * @param channel Channel to use, one of the UDMA_CH_* values
+ * @param src First byte to send
+ * @param dst Peripheral data register
+ * @param count Bytes to send, 1 to UDMA_MAX_TRANSFER
+ */
+void udma_sendBytes(int channel, const void *src, volatile uint32_t *dst, uint32_t count);
+
+/**
+ * Check and clear the completion flag of a channel. Call from the owning
+ * peripheral's interrupt handler.
+ * @return 1 if the channel finished a transfer since the last call
+ */
+int udma_takeDone(int channel);
+
+#endif /* UDMA_H_ */
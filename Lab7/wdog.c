@@ -0,0 +1,243 @@
+/*
+ * wdog.c
+ *
+ * Watchdog supervisor for blocking control loops using WATCHDOG0
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stdio.h>
+#include <inc/tm4c123gh6pm.h>
+#include "driverlib/interrupt.h" // for IntRegister
+#include "driverlib/cpu.h" // for CPUcpsid, CPUcpsie
+#include "wdog.h"
+#include "clock.h"
+#include "Timer.h"
+#include "uart.h"
+#include "open_interface.h"
+
+#define WDOG_RECORD_MAGIC 0x57444F47 // "WDOG"
+#define WDOG_UNLOCK       0x1ACCE551 // Written to LOCK to allow register writes
+#define WDOG_IDLE_LOAD    0xFFFFFFFF // Timeout while no loop is running, about 4.5 minutes at 16MHz
+
+/// One supervised loop on the nest stack
+typedef struct {
+    wdog_loop_t loop;
+    uint32_t timeout_ms;
+    uint32_t deadline;   // timer_getMicros() value, compared with wrap-safe subtraction
+} wdog_frame_t;
+
+static wdog_frame_t stack[WDOG_MAX_DEPTH];
+static volatile int depth = 0;
+static volatile int overflow = 0;      // Loops begun past WDOG_MAX_DEPTH, not supervised
+static volatile int tripped = 0;       // A deadline was missed and the nest is unwinding
+static volatile int acknowledged = 0;  // Code has seen the miss through wdog_feed()/wdog_end()
+static volatile int grace = 0;         // Checks left before the chip is allowed to reset
+static uint32_t misses[WDOG_NUM_LOOPS];
+
+// Kept through a watchdog reset so the next boot can report it
+#if defined(__TI_COMPILER_VERSION__)
+#pragma NOINIT(last_miss)
+#endif
+static wdog_record_t last_miss;
+
+// Names printed by wdog_dump(), in the same order as wdog_loop_t
+static const char *loop_names[WDOG_NUM_LOOPS] = {
+    "move",
+    "turn",
+    "move_smart",
+    "go_to_position",
+    "scan",
+};
+
+static void wdog_handler(void);
+
+/**
+ * Reload WATCHDOG0 with a new timeout, and start it the first time. The
+ * registers ignore writes while locked, and the handler locks them again,
+ * so interrupts stay masked until they are locked.
+ */
+static void wdog_reload(uint32_t load)
+{
+    uint32_t was_masked = CPUcpsid();
+
+    WATCHDOG0_LOCK_R = WDOG_UNLOCK;
+    WATCHDOG0_LOAD_R = load;             // Writing LOAD restarts the count
+    WATCHDOG0_CTL_R |= WDT_CTL_INTEN;    // Interrupt on the first timeout, starts the counter
+    WATCHDOG0_LOCK_R = 0;
+
+    if (!was_masked) {
+        CPUcpsie();
+    }
+}
+
+void wdog_init(void)
+{
+    char buffer[100];
+
+    // A record from before a watchdog reset is only valid if the reset was ours
+    if ((SYSCTL_RESC_R & SYSCTL_RESC_WDT0) && last_miss.magic == WDOG_RECORD_MAGIC) {
+        last_miss.reset = 1;
+        sprintf(buffer, "\r\nWatchdog reset: %s loop hung, %lums past its %lums deadline\r\n",
+                loop_names[last_miss.loop % WDOG_NUM_LOOPS],
+                (unsigned long)last_miss.late_ms,
+                (unsigned long)last_miss.timeout_ms);
+        uart_sendStr(buffer);
+    }
+    else {
+        last_miss.magic = 0;
+    }
+    SYSCTL_RESC_R &= ~SYSCTL_RESC_WDT0; // Clear the reset cause for next time
+
+    SYSCTL_RCGCWD_R |= SYSCTL_RCGCWD_R0; // Turn on clock to WATCHDOG0
+    while ((SYSCTL_PRWD_R & SYSCTL_PRWD_R0) == 0) {};
+
+    // INTEN can't be cleared once set, so the counter is only started by the
+    // first wdog_begin(), and runs with WDOG_IDLE_LOAD while no loop is
+    // registered instead of waking idle every WDOG_PERIOD_MS
+    WATCHDOG0_LOCK_R = WDOG_UNLOCK;
+    WATCHDOG0_TEST_R |= WDT_TEST_STALL;  // Stop counting while the debugger halts the CPU
+    WATCHDOG0_CTL_R |= WDT_CTL_RESEN;    // Reset on the second timeout
+    WATCHDOG0_LOCK_R = 0;                // Lock the registers again
+
+    // Highest priority so a handler stuck in a blocking call can't hide a miss
+    NVIC_PRI4_R = (NVIC_PRI4_R & ~NVIC_PRI4_INT18_M) | (0 << NVIC_PRI4_INT18_S);
+    NVIC_EN0_R |= (1 << 18);             // Enable WATCHDOG0 interrupts (IRQ 18)
+    IntRegister(INT_WATCHDOG, wdog_handler); // Bind the ISR
+}
+
+void wdog_begin(wdog_loop_t loop, uint32_t timeout_ms)
+{
+    if (depth >= WDOG_MAX_DEPTH) {
+        overflow++;
+        return;
+    }
+
+    stack[depth].loop = loop;
+    stack[depth].timeout_ms = timeout_ms;
+    stack[depth].deadline = timer_getMicros() + timeout_ms * 1000;
+    depth++; // Publish the frame last so the ISR never sees it half written
+
+    if (depth == 1) {
+        wdog_reload(CLOCK_TICKS_PER_MILLI * WDOG_PERIOD_MS); // Start checking deadlines
+    }
+}
+
+int wdog_feed(void)
+{
+    if (tripped) {
+        acknowledged = 1;
+        return 1;
+    }
+
+    if (depth > 0 && !overflow) {
+        wdog_frame_t *f = &stack[depth - 1];
+        f->deadline = timer_getMicros() + f->timeout_ms * 1000;
+    }
+
+    return 0;
+}
+
+void wdog_end(void)
+{
+    if (overflow) {
+        overflow--;
+        return;
+    }
+    if (depth == 0) {
+        return;
+    }
+
+    depth--;
+    if (depth > 0) {
+        // The outer loop was waiting on this one, give it a fresh deadline
+        wdog_frame_t *f = &stack[depth - 1];
+        f->deadline = timer_getMicros() + f->timeout_ms * 1000;
+    }
+    else {
+        if (tripped) {
+            // Whole nest has unwound, start supervising normally again
+            acknowledged = 0;
+            tripped = 0;
+        }
+        wdog_reload(WDOG_IDLE_LOAD); // Nothing to check until the next loop
+    }
+}
+
+int wdog_tripped(void)
+{
+    if (tripped) {
+        acknowledged = 1;
+    }
+    return tripped;
+}
+
+uint32_t wdog_getMisses(wdog_loop_t loop)
+{
+    return misses[loop];
+}
+
+const wdog_record_t *wdog_getLastMiss(void)
+{
+    return last_miss.magic == WDOG_RECORD_MAGIC ? &last_miss : 0;
+}
+
+void wdog_dump(void)
+{
+    char buffer[100];
+    int i;
+
+    uart_sendStr("\r\nLoop             Misses\r\n");
+    uart_sendStr("------------------------\r\n");
+    for (i = 0; i < WDOG_NUM_LOOPS; i++) {
+        sprintf(buffer, "%-15s %7lu\r\n", loop_names[i], (unsigned long)misses[i]);
+        uart_sendStr(buffer);
+    }
+
+    if (last_miss.magic == WDOG_RECORD_MAGIC) {
+        sprintf(buffer, "\r\nLast miss: %s, %lums past its %lums deadline%s\r\n",
+                loop_names[last_miss.loop % WDOG_NUM_LOOPS],
+                (unsigned long)last_miss.late_ms,
+                (unsigned long)last_miss.timeout_ms,
+                last_miss.reset ? ", reset the chip" : "");
+        uart_sendStr(buffer);
+    }
+
+    uart_sendStr("\r\n");
+}
+
+/**
+ * WATCHDOG0 timeout handler. Clearing the interrupt reloads the counter, so
+ * leaving it set lets the second timeout reset the chip.
+ */
+static void wdog_handler(void)
+{
+    uint32_t now = timer_getMicros();
+
+    if (tripped) {
+        // Keep the chip alive only while the loops are unwinding
+        if (!acknowledged && grace-- <= 0) {
+            return;
+        }
+    }
+    else if (depth > 0 && !overflow && (int32_t)(now - stack[depth - 1].deadline) > 0) {
+        wdog_frame_t *f = &stack[depth - 1];
+
+        oi_setWheels(0, 0); // Stop before anything else, the loop may never return
+
+        misses[f->loop]++;
+        last_miss.loop = f->loop;
+        last_miss.reset = 0;
+        last_miss.late_ms = (now - f->deadline) / 1000;
+        last_miss.timeout_ms = f->timeout_ms;
+        last_miss.magic = WDOG_RECORD_MAGIC;
+
+        acknowledged = 0;
+        grace = WDOG_GRACE_PERIODS;
+        tripped = 1;
+    }
+
+    WATCHDOG0_LOCK_R = WDOG_UNLOCK;
+    WATCHDOG0_ICR_R = 1; // Clear the interrupt and reload the counter
+    WATCHDOG0_LOCK_R = 0;
+}
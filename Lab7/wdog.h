@@ -0,0 +1,83 @@
+/*
+ * wdog.h
+ *
+ * Watchdog supervisor for blocking control loops. A loop calls wdog_begin()
+ * before it starts, wdog_feed() once per iteration and wdog_end() when it is
+ * done. While any loop is running, WATCHDOG0 interrupts every WDOG_PERIOD_MS
+ * and checks the deadline of the innermost one; otherwise it is stretched to
+ * its longest timeout so idle isn't woken.
+ *
+ * On a missed deadline the wheels are stopped, the miss is recorded, and
+ * wdog_feed() and wdog_tripped() return 1 until the outermost loop ends, so
+ * every loop in the nest can unwind. If the code never notices the miss
+ * within WDOG_GRACE_PERIODS, the interrupt is left uncleared and WATCHDOG0
+ * resets the chip. The miss record survives the reset and wdog_init()
+ * reports it.
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#ifndef WDOG_H_
+#define WDOG_H_
+
+#include <stdint.h>
+
+#define WDOG_PERIOD_MS      100 // WATCHDOG0 timeout, how often deadlines are checked
+#define WDOG_GRACE_PERIODS  5   // Checks to wait for a loop to notice a miss before resetting
+#define WDOG_MAX_DEPTH      4   // Deepest nest of supervised loops
+
+/// Supervised loops, add new loops before WDOG_NUM_LOOPS and name them in wdog.c
+typedef enum {
+    WDOG_MOVE,
+    WDOG_TURN,
+    WDOG_MOVE_SMART,
+    WDOG_GO_TO_POSITION,
+    WDOG_SCAN,
+    WDOG_NUM_LOOPS
+} wdog_loop_t;
+
+/// Details of the most recent deadline miss
+typedef struct {
+    uint32_t magic;      // WDOG_RECORD_MAGIC when the record is valid
+    uint8_t loop;        // wdog_loop_t that missed its deadline
+    uint8_t reset;       // 1 if the miss ended in a watchdog reset
+    uint32_t late_ms;    // How far past the deadline the miss was caught
+    uint32_t timeout_ms; // Deadline the loop registered
+} wdog_record_t;
+
+/**
+ * Set up WATCHDOG0, counting starts with the first wdog_begin(), and report over UART1 if the last reset was caused by a
+ * loop that never recovered. Call after timer_init() and uart_interrupt_init().
+ */
+void wdog_init(void);
+
+/**
+ * Start supervising a loop. The loop must call wdog_feed() at least every
+ * timeout_ms until wdog_end(). Loops started inside it suspend its deadline.
+ * @param loop Loop being supervised
+ * @param timeout_ms Longest allowed time between feeds
+ */
+void wdog_begin(wdog_loop_t loop, uint32_t timeout_ms);
+
+/**
+ * Push the innermost loop's deadline out by its timeout.
+ * @return 1 if a deadline was missed and the loop must stop, 0 otherwise
+ */
+int wdog_feed(void);
+
+/// Stop supervising the innermost loop, and restart the deadline of the loop around it
+void wdog_end(void);
+
+/// Return 1 if a deadline was missed and blocking code should give up waiting
+int wdog_tripped(void);
+
+/// Get how many times a loop missed its deadline since reset
+uint32_t wdog_getMisses(wdog_loop_t loop);
+
+/// Get the most recent miss, or NULL if there hasn't been one
+const wdog_record_t *wdog_getLastMiss(void);
+
+/// Send the miss counts and the most recent miss over UART1
+void wdog_dump(void);
+
+#endif /* WDOG_H_ */
@@ -13,6 +13,7 @@
 #include "movement.h"
 #include "adc.h"
 #include "button.h"
+#include "fmt.h"
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -73,8 +74,16 @@ int main(void) {
         float distance = calculate_distance(avgAdc);
 
         // Clear the LCD and display both values.
+        char line[100];
+        fmt_t f;
+        fmt_init(&f, line, sizeof(line));
+        fmt_str(&f, "ADC: ");
+        fmt_int(&f, avgAdc, 0);
+        fmt_str(&f, "\nDist: ");
+        fmt_float(&f, distance, 1, 0);
+        fmt_str(&f, " cm");
         lcd_clear();
-        lcd_printf("ADC: %d\nDist: %.1f cm", avgAdc, distance);
+        lcd_printStr(line);
 
         // Delay before the next sample cycle.
         timer_waitMillis(500);
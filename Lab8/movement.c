@@ -10,6 +10,7 @@
 #include "movement.h"
 #include "Timer.h"
 #include "uart.h"
+#include "fmt.h"
 
 /**
  * Move the robot forward by the specified distance in millimeters
@@ -222,10 +223,15 @@ void faster_turn_left(oi_t *sensor_data, double degrees)
 int go_to_position(oi_t *sensor_data, float angle, float distance_cm)
 {
     char buffer[100];
+    fmt_t f;
 
     // DEBUGGING: Print the actual values coming in
-    sprintf(buffer, "DEBUG - Received: angle=%.1f, distance=%.1f\r\n", angle,
-            distance_cm);
+    fmt_init(&f, buffer, sizeof(buffer));
+    fmt_str(&f, "DEBUG - Received: angle=");
+    fmt_float(&f, angle, 1, 0);
+    fmt_str(&f, ", distance=");
+    fmt_float(&f, distance_cm, 1, 0);
+    fmt_str(&f, "\r\n");
     uart_sendStr(buffer);
 
     // 1. Turn to face the target
@@ -236,7 +242,10 @@ int go_to_position(oi_t *sensor_data, float angle, float distance_cm)
         // Object is to the right
         turnDirection = 1;
         degreesToTurn = 90 - angle;
-        sprintf(buffer, "Turning right %.1f degrees\r\n", degreesToTurn);
+        fmt_init(&f, buffer, sizeof(buffer));
+        fmt_str(&f, "Turning right ");
+        fmt_float(&f, degreesToTurn, 1, 0);
+        fmt_str(&f, " degrees\r\n");
         uart_sendStr(buffer);
 
         // Make sure the turn angle is sufficiently large to matter
@@ -255,7 +264,10 @@ int go_to_position(oi_t *sensor_data, float angle, float distance_cm)
         // Object is to the left
         turnDirection = 0;
         degreesToTurn = angle - 90;
-        sprintf(buffer, "Turning left %.1f degrees\r\n", degreesToTurn);
+        fmt_init(&f, buffer, sizeof(buffer));
+        fmt_str(&f, "Turning left ");
+        fmt_float(&f, degreesToTurn, 1, 0);
+        fmt_str(&f, " degrees\r\n");
         uart_sendStr(buffer);
 
         // Make sure the turn angle is sufficiently large to matter
@@ -293,8 +305,12 @@ int go_to_position(oi_t *sensor_data, float angle, float distance_cm)
     float move_distance_mm = move_distance * 10.0f;
 
     // Print the intended movement
-    sprintf(buffer, "Moving forward %.1f cm (%.0f mm)\r\n", move_distance,
-            move_distance_mm);
+    fmt_init(&f, buffer, sizeof(buffer));
+    fmt_str(&f, "Moving forward ");
+    fmt_float(&f, move_distance, 1, 0);
+    fmt_str(&f, " cm (");
+    fmt_float(&f, move_distance_mm, 0, 0);
+    fmt_str(&f, " mm)\r\n");
     uart_sendStr(buffer);
 
     // 3. Move forward, watching for bumps
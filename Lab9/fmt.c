@@ -0,0 +1,125 @@
+/*
+ * fmt.c
+ *
+ * Allocation-free formatting of strings, integers and fixed-point decimals
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include "fmt.h"
+
+// 10 digits, a decimal point and a sign
+#define FMT_NUMBER_SIZE 12
+
+static const uint32_t pow10[FMT_MAX_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// Write the digits of a magnitude with a decimal point before the last
+// decimals digits, padded on the left to width. Leaves the string terminated.
+static void put_number(fmt_t *f, uint32_t magnitude, int negative, int decimals, int width)
+{
+    char digits[FMT_NUMBER_SIZE];
+    int n = 0;
+    int count = 0;
+
+    // Digits come out lowest first, so build the number backwards
+    do {
+        digits[n++] = '0' + magnitude % 10;
+        magnitude /= 10;
+        if (++count == decimals) {
+            digits[n++] = '.';
+        }
+    } while (magnitude != 0 || count <= decimals);
+    if (negative) {
+        digits[n++] = '-';
+    }
+
+    for (; width > n && f->len < f->size - 1; width--) {
+        f->buf[f->len++] = ' ';
+    }
+    while (n > 0 && f->len < f->size - 1) {
+        f->buf[f->len++] = digits[--n];
+    }
+    f->buf[f->len] = '\0';
+}
+
+static int clamp_decimals(int decimals)
+{
+    if (decimals < 0) {
+        return 0;
+    }
+    return decimals > FMT_MAX_DECIMALS ? FMT_MAX_DECIMALS : decimals;
+}
+
+void fmt_init(fmt_t *f, char *buf, int size)
+{
+    f->buf = buf;
+    f->size = size;
+    f->len = 0;
+    if (size > 0) {
+        buf[0] = '\0';
+    }
+}
+
+void fmt_char(fmt_t *f, char c)
+{
+    if (f->len < f->size - 1) {
+        f->buf[f->len++] = c;
+        f->buf[f->len] = '\0';
+    }
+}
+
+void fmt_str(fmt_t *f, const char *s)
+{
+    while (*s && f->len < f->size - 1) {
+        f->buf[f->len++] = *s++;
+    }
+    if (f->size > 0) {
+        f->buf[f->len] = '\0';
+    }
+}
+
+void fmt_int(fmt_t *f, int32_t value, int width)
+{
+    fmt_fixed(f, value, 0, width);
+}
+
+void fmt_uint(fmt_t *f, uint32_t value, int width)
+{
+    if (f->size > 0) {
+        put_number(f, value, 0, 0, width);
+    }
+}
+
+void fmt_fixed(fmt_t *f, int32_t value, int decimals, int width)
+{
+    // Negate as unsigned so INT32_MIN doesn't overflow
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+
+    if (f->size > 0) {
+        put_number(f, magnitude, value < 0, clamp_decimals(decimals), width);
+    }
+}
+
+void fmt_float(fmt_t *f, float value, int decimals, int width)
+{
+    int negative = value < 0;
+    float scaled;
+    uint32_t magnitude;
+
+    decimals = clamp_decimals(decimals);
+    scaled = (negative ? -value : value) * pow10[decimals] + 0.5f;
+
+    // Largest float below 2^32, also catches NaN
+    if (!(scaled < 4294967040.0f)) {
+        magnitude = scaled > 0 ? 0xFFFFFFFF : 0;
+    }
+    else {
+        magnitude = (uint32_t)scaled;
+    }
+
+    if (f->size > 0) {
+        put_number(f, magnitude, negative && magnitude != 0, decimals, width);
+    }
+}
@@ -8,6 +8,7 @@
 #include "ping.h"
 #include "cyBot_Scan.h"  // For CyBot scanner functions
 #include "open_interface.h"  // For Open Interface functions
+#include "fmt.h"
 
 #define LEFT_CAL 1256500
 #define RIGHT_CAL 274750
@@ -45,15 +46,19 @@ int main(void) {
         unsigned int overflow_count = ping_getOverflowCount();
 
         // Display the results on LCD
+        char line[100];
+        fmt_t f;
+        fmt_init(&f, line, sizeof(line));
+        fmt_str(&f, "Pulse: ");
+        fmt_uint(&f, pulse_width_cycles, 0);
+        fmt_str(&f, " c\nTime: ");
+        fmt_float(&f, pulse_width_ms, 3, 0);
+        fmt_str(&f, " ms\nDist: ");
+        fmt_float(&f, distance_cm, 1, 0);
+        fmt_str(&f, " cm\nOflows: ");
+        fmt_uint(&f, overflow_count, 0);
         lcd_clear();
-        lcd_printf("Pulse: %u c\n"
-                   "Time: %.3f ms\n"
-                   "Dist: %.1f cm\n"
-                   "Oflows: %u",
-                   pulse_width_cycles,
-                   pulse_width_ms,
-                   distance_cm,
-                   overflow_count);
+        lcd_printStr(line);
 
         // Wait before next measurement (as specified in lab)
         timer_waitMillis(300);
@@ -240,19 +240,30 @@ void lcd_setCursorPos(uint8_t x, uint8_t y) {
  */
 
 void lcd_printf(const char *format, ...) {
-	static char lastbuffer[LCD_TOTAL_CHARS + 1];
-
 	char buffer[LCD_TOTAL_CHARS + 1];
 	va_list arglist;
 	va_start(arglist, format);
 	vsnprintf(buffer, LCD_TOTAL_CHARS + 1, format, arglist);
+	va_end(arglist);
+
+	lcd_printStr(buffer);
+}
 
-	if (!strcmp(lastbuffer, buffer))
+/// Print an already formatted string to the LCD screen
+/**
+ * Same as lcd_printf() without the formatting, so strings built with fmt.h
+ * don't pull in vsnprintf. '\n' moves to the next line, and the screen is
+ * only redrawn when the string changes.
+ */
+void lcd_printStr(const char *str) {
+	static char lastbuffer[LCD_TOTAL_CHARS + 1];
+
+	if (!strncmp(lastbuffer, str, LCD_TOTAL_CHARS))
 		return;
 
-	strcpy(lastbuffer, buffer);
+	strncpy(lastbuffer, str, LCD_TOTAL_CHARS);
+	lastbuffer[LCD_TOTAL_CHARS] = '\0';
 	lcd_clear();
-	char *str = buffer;
 	int charnum = 0;
 	while (*str && charnum < LCD_TOTAL_CHARS) {
 		if (*str == '\n') {
@@ -289,6 +300,5 @@ void lcd_printf(const char *format, ...) {
 			}
 		}
 	}
-	va_end(arglist);
 }
 
@@ -43,6 +43,9 @@ void lcd_setCursorPos(uint8_t x, uint8_t y);
 
 void lcd_printf(const char *format, ...);
 
+///Print a string already formatted, '\n' starts the next line
+void lcd_printStr(const char *str);
+
 ///Send command to LCD - Position, Clear, Etc.
 void lcd_sendCommand(uint8_t data);
 
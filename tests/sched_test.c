@@ -0,0 +1,157 @@
+/*
+ * sched_test.c
+ *
+ * Host test for the scheduler core in Lab7/sched.c, driven by a simulated
+ * clock through sched_setClock(). Build and run from the repo root with
+ *
+ *   cc -std=c99 -Wall -ILab7 -o sched_test tests/sched_test.c Lab7/sched.c && ./sched_test
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sched.h"
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static int failures = 0;
+
+static void check(int ok, const char *what, int line)
+{
+    if (!ok) {
+        printf("FAIL line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+// Simulated clock in microseconds, tasks advance it by their execution time
+static uint64_t now_us = 0;
+
+static uint64_t sim_now(void)
+{
+    return now_us;
+}
+
+// One simulated task, run() records when each job started
+typedef struct {
+    int id;
+    uint32_t exec_us;
+} sim_task_t;
+
+#define MAX_LOG 256
+static struct {
+    int id;
+    uint64_t start;
+} job_log[MAX_LOG];
+static int num_logged = 0;
+
+static void sim_run(void *arg)
+{
+    sim_task_t *task = arg;
+
+    if (num_logged < MAX_LOG) {
+        job_log[num_logged].id = task->id;
+        job_log[num_logged].start = now_us;
+        num_logged++;
+    }
+    now_us += task->exec_us;
+}
+
+static void noop(void *arg)
+{
+}
+
+// Run the jobs released up to end_us, sleeping between them
+static void sim_until(uint64_t end_us)
+{
+    while (now_us <= end_us) {
+        if (sched_runOnce()) {
+            continue;
+        }
+        uint64_t next = sched_nextRelease();
+        if (next > end_us) {
+            break;
+        }
+        now_us = next;
+    }
+}
+
+int main(void)
+{
+    static sim_task_t odometry = {0, 1000};
+    static sim_task_t ranging = {1, 5000};
+    static sim_task_t ui = {2, 10000};
+    const sched_task_t *t;
+    int i;
+
+    // Nothing can be registered or run before there is a clock
+    CHECK(sched_addTask("early", noop, NULL, 10, 0) == -1);
+    CHECK(sched_runOnce() == 0);
+    CHECK(sched_nextRelease() == UINT64_MAX);
+
+    sched_setClock(sim_now);
+    CHECK(sched_addTask("odometry", sim_run, &odometry, 15, 0) == 0);
+    CHECK(sched_addTask("ranging", sim_run, &ranging, 50, 1) == 1);
+    CHECK(sched_addTask("ui", sim_run, &ui, 200, 2) == 2);
+    CHECK(sched_addTask("bad", NULL, NULL, 10, 0) == -1);
+    CHECK(sched_addTask("bad", noop, NULL, 0, 0) == -1);
+    CHECK(sched_nextRelease() == 15000);
+
+    // A second at 22% utilization, every release runs and meets its deadline
+    sim_until(999999);
+    CHECK(sched_getTask(0)->runs == 66);
+    CHECK(sched_getTask(1)->runs == 19);
+    CHECK(sched_getTask(2)->runs == 4);
+    for (i = 0; i < 3; i++) {
+        t = sched_getTask(i);
+        CHECK(t->misses == 0);
+        CHECK(t->skipped == 0);
+        CHECK(t->last_exec == ((sim_task_t *)t->arg)->exec_us);
+        CHECK(t->wcet == ((sim_task_t *)t->arg)->exec_us);
+    }
+    CHECK(sched_getTask(3) == NULL);
+    CHECK(sched_getTask(-1) == NULL);
+
+    // All three release together at 600ms and run in priority order
+    for (i = 0; i < num_logged && job_log[i].start < 600000; i++) {
+    }
+    CHECK(i + 2 < num_logged);
+    CHECK(job_log[i].id == 0 && job_log[i].start == 600000);
+    CHECK(job_log[i + 1].id == 1 && job_log[i + 1].start == 601000);
+    CHECK(job_log[i + 2].id == 2 && job_log[i + 2].start == 606000);
+
+    // A UI job that overruns its 200ms period misses its deadline once and
+    // drops the releases it covered instead of running them back to back
+    sched_resetStats();
+    CHECK(sched_getTask(0)->runs == 0);
+    ui.exec_us = 450000;
+    while (sched_getTask(2)->runs == 0) {
+        sim_until(now_us + 1000);
+        now_us += 1000;
+    }
+    t = sched_getTask(2);
+    CHECK(t->misses == 1);
+    CHECK(t->skipped == 2);
+    CHECK(t->last_exec == 450000);
+    CHECK(t->wcet == 450000);
+    CHECK(t->next_release > now_us);
+
+    // Odometry was blocked for the whole job, so it missed too
+    sim_until(now_us + 50000);
+    CHECK(sched_getTask(0)->misses >= 1);
+    CHECK(sched_getTask(0)->skipped > 0);
+
+    // The table holds SCHED_MAX_TASKS
+    for (i = 3; i < SCHED_MAX_TASKS; i++) {
+        CHECK(sched_addTask("filler", noop, NULL, 1000, 3) == i);
+    }
+    CHECK(sched_addTask("full", noop, NULL, 1000, 3) == -1);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("sched: all checks passed\n");
+    return 0;
+}
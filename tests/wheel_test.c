@@ -0,0 +1,178 @@
+/*
+ * wheel_test.c
+ *
+ * Host test for the timer wheel in Lab7/wheel.c, driven by calling
+ * wheel_tick() as a simulated 1ms TIMER4 tick. Build and run from the repo
+ * root with
+ *
+ *   cc -std=c99 -Wall -ILab7 -o wheel_test tests/wheel_test.c Lab7/wheel.c && ./wheel_test
+ *
+ * @author Jeremiah Baccam, Luke Patterson
+ */
+
+#include <stdio.h>
+#include "wheel.h"
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static int failures = 0;
+
+static void check(int ok, const char *what, int line)
+{
+    if (!ok) {
+        printf("FAIL line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+// Simulated time in ticks, and the tick each callback last ran on
+static unsigned int now = 0;
+
+static void tick(unsigned int ticks)
+{
+    while (ticks--) {
+        now++;
+        wheel_tick();
+    }
+}
+
+static int a_calls, b_calls, c_calls;
+static unsigned int a_last, b_last;
+
+static void count_a(void) { a_calls++; a_last = now; }
+static void count_b(void) { b_calls++; b_last = now; }
+static void count_c(void) { c_calls++; }
+
+// Handles the cancelling callbacks act on
+static int victim;
+static int self;
+
+static void cancel_victim(void) { a_calls++; wheel_cancel(victim); }
+static void cancel_self(void) { c_calls++; wheel_cancel(self); }
+
+static int rearm_handle;
+static void rearm(void) { b_calls++; rearm_handle = wheel_arm(count_a, 3, 1); }
+
+int main(void)
+{
+    int handles[WHEEL_MAX_TIMERS];
+    int h, i;
+
+    wheel_init();
+    CHECK(wheel_armed() == 0);
+    CHECK(wheel_arm(NULL, 5, 1) == -1);
+    CHECK(wheel_arm(count_a, 5, 0) == -1);
+
+    // One shot fires exactly once, on its tick
+    h = wheel_arm(count_a, 5, 1);
+    CHECK(h >= 0);
+    CHECK(wheel_armed() == 1);
+    tick(4);
+    CHECK(a_calls == 0);
+    tick(1);
+    CHECK(a_calls == 1 && a_last == 5);
+    tick(100);
+    CHECK(a_calls == 1);
+    CHECK(wheel_armed() == 0);
+    CHECK(wheel_cancel(h) == 0); // Already finished
+
+    // 0ms is the next tick
+    a_calls = 0;
+    wheel_arm(count_a, 0, 1);
+    tick(1);
+    CHECK(a_calls == 1);
+
+    // Repeating and counted timers
+    a_calls = b_calls = 0;
+    h = wheel_arm(count_a, 10, -1);
+    wheel_arm(count_b, 7, 3);
+    tick(100);
+    CHECK(a_calls == 10);
+    CHECK(b_calls == 3);
+    CHECK(wheel_armed() == 1);
+    CHECK(wheel_cancel(h) == 1);
+    CHECK(wheel_cancel(h) == 0);
+    tick(100);
+    CHECK(a_calls == 10);
+    CHECK(wheel_armed() == 0);
+
+    // Longer than one turn of the wheel
+    a_calls = 0;
+    unsigned int start = now;
+    wheel_arm(count_a, WHEEL_SLOTS * 3 + 5, 2);
+    tick(WHEEL_SLOTS * 3 + 4);
+    CHECK(a_calls == 0);
+    tick(1);
+    CHECK(a_calls == 1 && a_last == start + WHEEL_SLOTS * 3 + 5);
+    tick(WHEEL_SLOTS * 3 + 5);
+    CHECK(a_calls == 2 && a_last == start + 2 * (WHEEL_SLOTS * 3 + 5));
+    CHECK(wheel_armed() == 0);
+
+    // A stale handle can't cancel the timer that reused its slot
+    h = wheel_arm(count_a, 5, 1);
+    tick(5);
+    b_calls = 0;
+    i = wheel_arm(count_b, 5, 1);
+    CHECK((i & 0xFF) == (h & 0xFF));
+    CHECK(wheel_cancel(h) == 0);
+    tick(5);
+    CHECK(b_calls == 1);
+
+    // A callback cancels a timer due later in the same tick, repeating or
+    // on its last call, and neither runs. Arming order is reversed in the
+    // slot list, so arm the victims first.
+    a_calls = b_calls = c_calls = 0;
+    victim = wheel_arm(count_b, 4, -1);
+    wheel_arm(cancel_victim, 4, 1);
+    tick(4);
+    CHECK(a_calls == 1);
+    CHECK(b_calls == 0);
+    tick(20);
+    CHECK(b_calls == 0);
+    CHECK(wheel_armed() == 0);
+
+    a_calls = b_calls = 0;
+    victim = wheel_arm(count_b, 4, 1);
+    wheel_arm(cancel_victim, 4, 1);
+    tick(4);
+    CHECK(a_calls == 1);
+    CHECK(b_calls == 0);
+    CHECK(wheel_armed() == 0);
+
+    // A timer can cancel itself from its own callback
+    c_calls = 0;
+    self = wheel_arm(cancel_self, 2, -1);
+    tick(10);
+    CHECK(c_calls == 1);
+    CHECK(wheel_armed() == 0);
+
+    // A callback can arm a new timer
+    a_calls = b_calls = 0;
+    wheel_arm(rearm, 2, 1);
+    tick(2);
+    CHECK(b_calls == 1);
+    CHECK(wheel_armed() == 1);
+    tick(3);
+    CHECK(a_calls == 1);
+    CHECK(wheel_armed() == 0);
+
+    // Every timer can be armed at once, and no more
+    c_calls = 0;
+    for (i = 0; i < WHEEL_MAX_TIMERS; i++) {
+        handles[i] = wheel_arm(count_c, 1 + i % 7, 1);
+        CHECK(handles[i] >= 0);
+    }
+    CHECK(wheel_arm(count_c, 1, 1) == -1);
+    CHECK(wheel_armed() == WHEEL_MAX_TIMERS);
+    CHECK(wheel_cancel(handles[3]) == 1);
+    tick(7);
+    CHECK(c_calls == WHEEL_MAX_TIMERS - 1);
+    CHECK(wheel_armed() == 0);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("wheel: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,333 @@
+#!/usr/bin/env python3
+"""
+ground_station.py
+
+Live view of a CyBot running Lab7 with binary telemetry on ('b'). Reads the
+UART1 stream from a serial device or a pseudo-terminal, draws the IR and
+ping readings of the latest scan and the detected objects on a polar plot,
+and shows odometry and the console text. Sessions can be recorded and
+replayed later, faster than real time if wanted.
+
+    ./ground_station.py /dev/ttyUSB0 --record run1.cyb
+    ./ground_station.py /dev/ttyUSB0 --switch-baud 921600
+    ./ground_station.py --replay run1.cyb --speed 10
+    ./ground_station.py --replay run1.cyb --speed 0 --no-gui    # decode only, as fast as possible
+
+Keys typed in the window are sent to the robot, so it can be driven like
+from PuTTY. Decoding runs in its own thread and the plot is redrawn at most
+every REDRAW_MS, so bursts of frames never back up behind the drawing.
+
+Session file: SESSION_MAGIC, then chunks of f64 seconds since the start,
+u32 length, and the bytes exactly as read. A plain capture made with
+cat /dev/ttyUSB0 > capture.bin can be replayed too, it is paced by --baud.
+
+Only the Python standard library is used, Tk is needed for the window.
+
+@author Jeremiah Baccam, Luke Patterson
+"""
+
+import argparse
+import math
+import os
+import struct
+import sys
+import threading
+import time
+
+from telemetry_decode import Decoder, LOG, OBJECT, ODOMETRY, SCAN, TEXT
+from uart_baud import BAUD_RATES, negotiate, open_serial
+
+SESSION_MAGIC = b"CYBOTSESSION1\n"
+CHUNK = struct.Struct("<dI")
+
+REDRAW_MS = 50          # Shortest time between two redraws
+CONSOLE_LINES = 200     # Console lines kept in the window
+IR_FULL_SCALE = 4095    # Largest IR raw reading, drawn at the plot range
+
+
+class Recorder:
+    """Writes everything read from the robot to a session file."""
+
+    def __init__(self, path):
+        self.file = open(path, "wb")
+        self.file.write(SESSION_MAGIC)
+        self.start = time.monotonic()
+        self.lock = threading.Lock()   # The reader may still be blocked in a read at exit
+
+    def write(self, data):
+        with self.lock:
+            if not self.file.closed:
+                self.file.write(CHUNK.pack(time.monotonic() - self.start, len(data)))
+                self.file.write(data)
+
+    def close(self):
+        with self.lock:
+            self.file.close()
+
+
+def read_session(path, baud):
+    """Yield (seconds since the start, bytes) from a session or plain capture."""
+    with open(path, "rb") as f:
+        if f.read(len(SESSION_MAGIC)) == SESSION_MAGIC:
+            while True:
+                header = f.read(CHUNK.size)
+                if len(header) < CHUNK.size:
+                    return
+                stamp, length = CHUNK.unpack(header)
+                yield stamp, f.read(length)
+        f.seek(0)
+        stamp = 0.0
+        while True:
+            data = f.read(256)
+            if not data:
+                return
+            yield stamp, data
+            stamp += len(data) * 10 / baud   # 8N1, 10 bits a byte
+
+
+class Model:
+    """What the window shows, updated by the reader thread under lock."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.version = 0        # Bumped on every change, the window redraws when it moves
+        self.scan = {}          # angle -> (ir_raw, ping_mm) of the sweep being drawn
+        self.last_angle = None
+        self.objects = {}       # index -> (start_deg, end_deg, distance_mm, width_mm)
+        self.odometry = None    # (distance_mm, heading_deg)
+        self.time_ms = 0
+        self.console = []
+        self.partial = ""       # Console text after the last newline
+        self.log_frames = 0
+        self.bytes = 0
+        self.finished = False
+
+    def apply(self, records, length):
+        with self.lock:
+            self.bytes += length
+            for kind, row in records:
+                if kind == SCAN:
+                    _, time_ms, angle, ir_raw, ping_mm = row
+                    if self.last_angle is not None and angle < self.last_angle:
+                        self.scan = {}      # A new sweep started
+                    self.last_angle = angle
+                    self.scan[angle] = (ir_raw, ping_mm)
+                elif kind == OBJECT:
+                    _, time_ms, index, start, end, distance, width = row
+                    if index == 0:
+                        self.objects = {}   # Objects are sent in order after every scan
+                    self.objects[index] = (start, end, distance, width)
+                elif kind == ODOMETRY:
+                    _, time_ms, distance, heading = row
+                    self.odometry = (distance, heading)
+                elif kind == LOG:
+                    time_ms = row[1]
+                    self.log_frames += 1
+                    continue
+                elif kind == TEXT:
+                    self._text(row.decode("latin-1"))
+                    continue
+                self.time_ms = time_ms
+            self.version += 1
+
+    def _text(self, text):
+        lines = (self.partial + text.replace("\r", "")).split("\n")
+        self.partial = lines.pop()
+        self.console += lines
+        del self.console[:-CONSOLE_LINES]
+
+    def snapshot(self):
+        with self.lock:
+            return (self.version, dict(self.scan), dict(self.objects), self.odometry,
+                    self.time_ms, self.console + [self.partial], self.bytes, self.finished)
+
+
+class Reader(threading.Thread):
+    """Reads the live stream or a replay, decodes it and updates the model."""
+
+    def __init__(self, model, fd=None, replay=None, speed=1.0, baud=115200, recorder=None):
+        super().__init__(daemon=True)
+        self.model = model
+        self.fd = fd
+        self.replay = replay
+        self.speed = speed
+        self.baud = baud
+        self.recorder = recorder
+        self.decoder = Decoder()
+        self.stop = threading.Event()
+        self.elapsed = 0.0
+
+    def run(self):
+        start = time.monotonic()
+        try:
+            if self.replay:
+                for stamp, data in read_session(self.replay, self.baud):
+                    if self.stop.is_set():
+                        break
+                    if self.speed > 0:
+                        delay = start + stamp / self.speed - time.monotonic()
+                        if delay > 0:
+                            time.sleep(delay)
+                    self._handle(data)
+            else:
+                while not self.stop.is_set():
+                    data = os.read(self.fd, 4096)
+                    if not data:
+                        break
+                    self._handle(data)
+        except OSError as e:
+            # A pty reads EIO once the other end closes
+            print("read stopped: %s" % e, file=sys.stderr)
+        self.elapsed = time.monotonic() - start
+        with self.model.lock:
+            self.model.finished = True
+            self.model.version += 1
+
+    def _handle(self, data):
+        if self.recorder:
+            self.recorder.write(data)
+        self.model.apply(self.decoder.feed(data), len(data))
+
+
+class Window:
+    """Tk window with the polar plot, a status line and the console."""
+
+    def __init__(self, model, reader, range_cm, fd):
+        import tkinter as tk
+
+        self.model = model
+        self.reader = reader
+        self.range_mm = range_cm * 10
+        self.fd = fd
+        self.drawn = -1
+
+        self.root = tk.Tk()
+        self.root.title("CyBot ground station")
+        self.canvas = tk.Canvas(self.root, width=640, height=360, background="white")
+        self.canvas.pack(fill=tk.BOTH, expand=True)
+        self.status = tk.Label(self.root, anchor="w", font="TkFixedFont")
+        self.status.pack(fill=tk.X)
+        self.console = tk.Text(self.root, height=12, font="TkFixedFont")
+        self.console.pack(fill=tk.BOTH, expand=True)
+        self.root.bind("<Key>", self._key)
+        self.canvas.bind("<Configure>", lambda event: self._invalidate())
+
+    def run(self):
+        self.root.after(REDRAW_MS, self._tick)
+        self.root.mainloop()
+
+    def _invalidate(self):
+        self.drawn = -1
+
+    def _key(self, event):
+        if self.fd is not None and event.char:
+            os.write(self.fd, event.char.encode("latin-1", "replace"))
+
+    def _tick(self):
+        snapshot = self.model.snapshot()
+        if snapshot[0] != self.drawn:
+            self.drawn = snapshot[0]
+            self._draw(*snapshot[1:])
+        self.root.after(REDRAW_MS, self._tick)
+
+    def _point(self, angle, distance_mm):
+        # Robot at the bottom middle, 0 degrees to the right like the servo
+        width = self.canvas.winfo_width()
+        height = self.canvas.winfo_height()
+        scale = min(width / 2 - 20, height - 40) / self.range_mm
+        r = min(distance_mm, self.range_mm) * scale
+        return (width / 2 + r * math.cos(math.radians(angle)),
+                height - 20 - r * math.sin(math.radians(angle)))
+
+    def _draw(self, scan, objects, odometry, time_ms, console, total, finished):
+        c = self.canvas
+        c.delete("all")
+
+        # Range rings every 50 cm and spokes every 30 degrees
+        for ring_mm in range(500, int(self.range_mm) + 1, 500):
+            x0, y0 = self._point(180, ring_mm)
+            x1, _ = self._point(0, ring_mm)
+            c.create_arc(x0, y0 - (x1 - x0) / 2, x1, y0 + (x1 - x0) / 2,
+                         start=0, extent=180, style="arc", outline="#ddd")
+            c.create_text(x1, y0 + 8, text="%d" % (ring_mm // 10), fill="#999", font=("TkDefaultFont", 7))
+        for angle in range(0, 181, 30):
+            c.create_line(*self._point(angle, 0), *self._point(angle, self.range_mm), fill="#eee")
+
+        angles = sorted(scan)
+        ir = [self._point(a, scan[a][0] * self.range_mm / IR_FULL_SCALE) for a in angles]
+        if len(ir) > 1:
+            c.create_line(*[v for p in ir for v in p], fill="red")
+        for a in angles:
+            x, y = self._point(a, scan[a][1])
+            c.create_oval(x - 2, y - 2, x + 2, y + 2, fill="blue", outline="")
+
+        for index, (start, end, distance, width) in sorted(objects.items()):
+            points = [self._point(start + (end - start) * i / 8, distance) for i in range(9)]
+            c.create_line(*[v for p in points for v in p], fill="orange", width=4)
+            x, y = self._point((start + end) / 2, distance + 100)
+            c.create_text(x, y, text="%d: %.0f cm" % (index + 1, width / 10), fill="darkorange")
+
+        status = "t %8.3f s   %d points   %d objects" % (time_ms / 1000, len(scan), len(objects))
+        if odometry:
+            status += "   odometry %.1f cm %.1f deg" % (odometry[0] / 10, odometry[1])
+        decoder = self.reader.decoder
+        status += "   %d bytes, %d frames, %d bad, %d missing" % (
+            total, decoder.frames, decoder.bad_frames, decoder.seq_gaps)
+        if finished:
+            status += "   (end of stream)"
+        self.status.config(text=status + "   IR red (0-%d raw), ping blue" % IR_FULL_SCALE)
+
+        self.console.delete("1.0", "end")
+        self.console.insert("end", "\n".join(console))
+        self.console.see("end")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Live CyBot scan view and session recorder")
+    parser.add_argument("device", nargs="?", help="serial device or pty the robot's UART1 is on")
+    parser.add_argument("-r", "--replay", help="session file or plain capture to play back")
+    parser.add_argument("-w", "--record", help="write the session to this file")
+    parser.add_argument("-b", "--baud", type=int, choices=sorted(BAUD_RATES), default=115200,
+                        help="serial baud rate, also paces plain captures (default 115200)")
+    parser.add_argument("--switch-baud", type=int, choices=sorted(BAUD_RATES),
+                        help="ask the robot to move to this rate first, see uart_baud.py")
+    parser.add_argument("-s", "--speed", type=float, default=1.0,
+                        help="replay speed, 0 for as fast as possible (default 1)")
+    parser.add_argument("--range", type=float, default=250, help="plot range in cm (default 250)")
+    parser.add_argument("--no-gui", action="store_true", help="decode and record without a window")
+    args = parser.parse_args()
+
+    if (args.device is None) == (args.replay is None):
+        parser.error("give either a device or --replay")
+
+    fd = open_serial(args.device, args.baud) if args.device else None
+    if fd is not None and args.switch_baud:
+        if not negotiate(fd, args.baud, args.switch_baud):
+            parser.exit(1, "robot did not confirm %d baud\n" % args.switch_baud)
+        args.baud = args.switch_baud
+    recorder = Recorder(args.record) if args.record else None
+    model = Model()
+    reader = Reader(model, fd=fd, replay=args.replay, speed=args.speed, baud=args.baud,
+                    recorder=recorder)
+    reader.start()
+
+    try:
+        if args.no_gui:
+            while reader.is_alive():
+                reader.join(0.5)
+        else:
+            Window(model, reader, args.range, fd).run()
+    except KeyboardInterrupt:
+        pass
+    reader.stop.set()
+
+    if recorder:
+        recorder.close()
+    if not reader.is_alive():
+        rate = model.bytes / reader.elapsed / 1e6 if reader.elapsed > 0 else 0
+        print("%d bytes in %.2f s, %.2f MB/s" % (model.bytes, reader.elapsed, rate), file=sys.stderr)
+    print(reader.decoder.summary(), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
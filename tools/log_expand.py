@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""
+log_expand.py
+
+Turns the deferred log records sent by Lab7/log.c back into text. Format
+strings are read from the .logfmt section of the .out file that was
+flashed, so the tool has to be given the same build. Console text between
+frames is passed through, so this can stand in for PuTTY while logging.
+
+    stty -F /dev/ttyUSB0 115200 raw
+    ./log_expand.py /dev/ttyUSB0 --elf ../Lab7/Debug/Lab7.out
+
+@author Jeremiah Baccam, Luke Patterson
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+from telemetry_decode import Decoder, LOG, TEXT
+
+LEVELS = "DIWE"
+LOG_ID_DROPPED = 0x1FFF
+LOG_ID_BITS = 13
+
+# One C conversion: flags, width, precision, length modifier, conversion
+CONVERSION = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|j|z|t|L)?([diouxXcfFeEgGsp%])")
+
+
+def read_section(path, name):
+    """Return (address, bytes) of a section in an ELF file, 32 or 64 bit."""
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF":
+        raise ValueError("%s is not an ELF file" % path)
+    is64 = elf[4] == 2
+    endian = "<" if elf[5] == 1 else ">"
+    if is64:
+        shoff, = struct.unpack_from(endian + "Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", elf, 0x3A)
+        header = endian + "IIQQQQIIQQ"
+    else:
+        shoff, = struct.unpack_from(endian + "I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", elf, 0x2E)
+        header = endian + "IIIIIIIIII"
+
+    sections = [struct.unpack_from(header, elf, shoff + i * shentsize) for i in range(shnum)]
+    names = sections[shstrndx]
+    names_at = names[4]
+    for section in sections:
+        sh_name, _, _, sh_addr, sh_offset, sh_size = section[:6]
+        end = elf.index(b"\0", names_at + sh_name)
+        if elf[names_at + sh_name:end].decode() == name:
+            return sh_addr, elf[sh_offset:sh_offset + sh_size]
+    raise ValueError("%s has no %s section, was it built with log.c?" % (path, name))
+
+
+def format_record(fmt, args):
+    """printf() fmt with argument words the way the robot would have."""
+    words = iter(args)
+
+    def convert(match):
+        flags, width, precision, kind = match.groups()
+        if kind == "%":
+            return "%"
+        word = next(words, 0)
+        spec = "%" + flags + width + ("." + precision if precision is not None else "")
+        if kind in "di":
+            return (spec + "d") % (word - (1 << 32) if word & 0x80000000 else word)
+        if kind in "ouxX":
+            return (spec + kind) % word
+        if kind == "c":
+            return (spec + "c") % chr(word & 0xFF)
+        if kind in "fFeEgG":
+            value, = struct.unpack("<f", struct.pack("<I", word))
+            return (spec + kind) % value
+        return "<%s 0x%08x>" % (kind, word)
+
+    return CONVERSION.sub(convert, fmt)
+
+
+class Expander:
+    """Keeps the format table and the settings records are expanded with."""
+
+    def __init__(self, strings, clock_hz, min_level):
+        self.strings = strings
+        self.clock_hz = clock_hz
+        self.min_level = min_level
+
+    def lookup(self, offset):
+        end = self.strings.find(b"\0", offset)
+        if offset >= len(self.strings) or end < 0:
+            return None
+        return self.strings[offset:end].decode("latin-1")
+
+    def seconds(self, ticks, frame_ms):
+        # Only the low 32 bits of timer_getTicks() are sent, which wrap every
+        # 268s at 16MHz. The frame's time_ms comes from the same counter when
+        # the frame was sent, after every record in it was stored, so the
+        # record is the latest tick count at or before then with these low
+        # bits. Add a millisecond for time_ms being rounded down.
+        sent = int(frame_ms * self.clock_hz / 1000) + int(self.clock_hz / 1000)
+        return (sent - ((sent - ticks) & 0xFFFFFFFF)) / self.clock_hz
+
+    def expand(self, body, frame_ms):
+        lines = []
+        at = 0
+        while at + 6 <= len(body):
+            header, ticks = struct.unpack_from("<HI", body, at)
+            count = header >> LOG_ID_BITS
+            offset = header & ((1 << LOG_ID_BITS) - 1)
+            args = struct.unpack_from("<%dI" % count, body, at + 6)
+            at += 6 + 4 * count
+            stamp = self.seconds(ticks, frame_ms)
+
+            if offset == LOG_ID_DROPPED:
+                level, text = "W", "%d log records dropped, ring buffer was full" % args[0]
+            else:
+                fmt = self.lookup(offset)
+                if not fmt:
+                    level, text = "E", "unknown log string at offset %d, wrong .out file?" % offset
+                else:
+                    level, text = fmt[0], format_record(fmt[1:], args)
+            if LEVELS.find(level) >= self.min_level:
+                lines.append("[%11.6f] %s %s\n" % (stamp, level, text))
+        return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Expand CyBot deferred log records into text")
+    parser.add_argument("input", nargs="?", default="-",
+                        help="capture file or serial device, - for stdin (default)")
+    parser.add_argument("-e", "--elf", required=True, help=".out file the robot is running")
+    parser.add_argument("-c", "--clock-hz", type=float, default=16e6,
+                        help="timer_getTicks() rate, SYSCLK_HZ in clock.h (default 16000000)")
+    parser.add_argument("-l", "--level", choices=list(LEVELS), default="D",
+                        help="lowest level to print (default D)")
+    parser.add_argument("-q", "--quiet", action="store_true", help="don't pass console text through")
+    args = parser.parse_args()
+
+    _, strings = read_section(args.elf, ".logfmt")
+    expander = Expander(strings, args.clock_hz, LEVELS.index(args.level))
+    source = sys.stdin.buffer if args.input == "-" else open(args.input, "rb", buffering=0)
+    decoder = Decoder()
+
+    try:
+        while True:
+            chunk = source.read(4096)
+            if not chunk:
+                break
+            for kind, value in decoder.feed(chunk):
+                if kind == TEXT and not args.quiet:
+                    sys.stdout.write(value.decode("latin-1"))
+                elif kind == LOG:
+                    sys.stdout.writelines(expander.expand(value[2], value[1]))
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    print(decoder.summary(), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""
+telemetry_decode.py
+
+Decodes the binary telemetry frames sent by Lab7/telemetry.c back into CSV.
+Reads a capture file, a serial device already set up with stty, or stdin,
+and writes one CSV table for the chosen record type. Console text between
+frames is skipped. Frame format is described in Lab7/telemetry.h.
+Log records are expanded by log_expand.py instead.
+
+    stty -F /dev/ttyUSB0 115200 raw
+    cat /dev/ttyUSB0 > capture.bin
+    ./telemetry_decode.py capture.bin --type scan > scan.csv
+
+@author Jeremiah Baccam, Luke Patterson
+"""
+
+import argparse
+import binascii
+import struct
+import sys
+
+TEXT = 0      # Console text between frames, not a frame type
+SCAN = 1
+OBJECT = 2
+ODOMETRY = 3
+LOG = 4
+
+TYPE_NAMES = {"scan": SCAN, "object": OBJECT, "odometry": ODOMETRY}
+
+COLUMNS = {
+    SCAN: ["seq", "time_ms", "angle_deg", "ir_raw", "ping_mm"],
+    OBJECT: ["seq", "time_ms", "index", "start_deg", "end_deg", "distance_mm", "width_mm"],
+    ODOMETRY: ["seq", "time_ms", "distance_mm", "heading_deg"],
+}
+
+
+def cobs_decode(data):
+    """Undo COBS framing, returns None if the block is malformed."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        end = i + code
+        if end > len(data):
+            return None
+        out += data[i + 1:end]
+        i = end
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, same as crc16() in telemetry.c."""
+    return binascii.crc_hqx(data, 0xFFFF)
+
+
+def parse_frame(payload):
+    """Turn a checked payload into a list of (type, row) records."""
+    if len(payload) < 6:
+        return []
+    kind, seq = payload[0], payload[1]
+    (time_ms,) = struct.unpack_from("<I", payload, 2)
+    body = payload[6:]
+    if kind == SCAN:
+        rows = []
+        for i in range(0, len(body) - len(body) % 6, 6):
+            angle, b1, b2, b3, offset = struct.unpack_from("<BBBBH", body, i)
+            ir_raw = b1 | ((b2 & 0x0F) << 8)
+            ping_mm = (b2 >> 4) | (b3 << 4)
+            rows.append((SCAN, [seq, time_ms + offset, angle, ir_raw, ping_mm]))
+        return rows
+    if kind == OBJECT and len(body) >= 9:
+        index, start, end, distance, width = struct.unpack_from("<BHHHH", body)
+        return [(OBJECT, [seq, time_ms, index, start / 10, end / 10, distance, width])]
+    if kind == ODOMETRY and len(body) >= 8:
+        distance, heading = struct.unpack_from("<ii", body)
+        return [(ODOMETRY, [seq, time_ms, distance, heading / 10])]
+    if kind == LOG:
+        return [(LOG, [seq, time_ms, body])]
+    return []
+
+
+class Decoder:
+    """Incremental decoder, feed() bytes in any chunk size and get records back.
+
+    Every frame starts and ends with 0x00, so the decoder tracks whether it is
+    inside a frame and hands back console text between frames right away as
+    (TEXT, bytes) records.
+    """
+
+    def __init__(self):
+        self.block = bytearray()
+        self.in_frame = False
+        self.frames = 0
+        self.bad_frames = 0   # Blocks that looked like frames but failed the CRC
+        self.text_bytes = 0   # Console text and other bytes that were not frames
+        self.seq_gaps = 0     # Frames missing according to the sequence number
+        self.last_seq = None
+
+    def feed(self, data):
+        # Jump from delimiter to delimiter with find() rather than looking at
+        # every byte in Python, so replays can run far faster than the UART
+        records = []
+        start = 0
+        while True:
+            end = data.find(b"\0", start)
+            piece = data[start:] if end < 0 else data[start:end]
+            if self.in_frame:
+                self.block += piece
+            elif piece:
+                self.text_bytes += len(piece)
+                records.append((TEXT, bytes(piece)))
+            if end < 0:
+                return records
+            start = end + 1
+
+            if not self.in_frame:
+                self.in_frame = True
+            else:
+                self.in_frame = False
+                if self.block:
+                    records += self._finish(bytes(self.block))
+                    self.block.clear()
+
+    def _finish(self, block):
+        payload = cobs_decode(block)
+        if payload is None or len(payload) < 4 or \
+                crc16(payload[:-2]) != struct.unpack_from("<H", payload, len(payload) - 2)[0]:
+            # Printable text means the delimiters were read out of step, the
+            # 0x00 that ended it actually opens the next frame
+            if all(32 <= b < 127 or b in (9, 10, 13, 27) for b in block):
+                self.text_bytes += len(block)
+                self.in_frame = True
+                return [(TEXT, block)]
+            self.bad_frames += 1
+            return []
+        payload = payload[:-2]
+        self.frames += 1
+        if self.last_seq is not None:
+            self.seq_gaps += (payload[1] - self.last_seq - 1) & 0xFF
+        self.last_seq = payload[1]
+        return parse_frame(payload)
+
+    def summary(self):
+        return "%d frames, %d bad, %d missing, %d text bytes skipped" % (
+            self.frames, self.bad_frames, self.seq_gaps, self.text_bytes)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode CyBot binary telemetry into CSV")
+    parser.add_argument("input", nargs="?", default="-",
+                        help="capture file or serial device, - for stdin (default)")
+    parser.add_argument("-t", "--type", choices=sorted(TYPE_NAMES), default="scan",
+                        help="record type to write (default scan)")
+    parser.add_argument("-o", "--output", default="-", help="CSV file, - for stdout (default)")
+    args = parser.parse_args()
+
+    wanted = TYPE_NAMES[args.type]
+    source = sys.stdin.buffer if args.input == "-" else open(args.input, "rb", buffering=0)
+    sink = sys.stdout if args.output == "-" else open(args.output, "w")
+    decoder = Decoder()
+
+    sink.write(",".join(COLUMNS[wanted]) + "\n")
+    try:
+        while True:
+            chunk = source.read(4096)
+            if not chunk:
+                break
+            for kind, row in decoder.feed(chunk):
+                if kind == wanted:
+                    sink.write(",".join(str(v) for v in row) + "\n")
+            sink.flush()
+    except KeyboardInterrupt:
+        pass
+    print(decoder.summary(), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""
+uart_baud.py
+
+Host side of the Lab7 "baud" command. Asks the robot to switch UART1 to a
+new rate, follows it, and confirms so the robot keeps the new rate. The
+tty is left at the new rate for telemetry_decode.py or log_expand.py.
+
+    ./uart_baud.py /dev/ttyUSB0 921600
+    ./uart_baud.py /dev/ttyUSB0 115200 --from 921600    # back again
+
+Handshake, all lines end in \\r\\n:
+    host  "baud 921600"     at the old rate
+    robot "BAUD 921600 +0.64%" at the old rate, then switches
+    host  "\\rok"           at the new rate, within 2 s (BAUD_CONFIRM_MS)
+    robot "BAUD OK"         at the new rate, or goes back and sends
+          "BAUD REVERTED"   at the old rate
+The robot answers "BAUD FAIL" if it can't get within 2% of the rate.
+
+@author Jeremiah Baccam, Luke Patterson
+"""
+
+import argparse
+import os
+import select
+import sys
+import termios
+import time
+import tty
+
+BAUD_RATES = {rate: getattr(termios, "B%d" % rate) for rate in
+              (9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600)
+              if hasattr(termios, "B%d" % rate)}
+
+
+def set_baud(fd, baud):
+    """Change the rate of an open tty, does nothing for a pty stand-in."""
+    if os.isatty(fd):
+        attrs = termios.tcgetattr(fd)
+        attrs[4] = attrs[5] = BAUD_RATES[baud]
+        termios.tcsetattr(fd, termios.TCSADRAIN, attrs)
+
+
+def open_serial(path, baud):
+    """Open a tty or pty for reading and writing in raw mode."""
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        attrs[2] |= termios.CLOCAL | termios.CREAD
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        set_baud(fd, baud)
+    return fd
+
+
+def wait_for(fd, patterns, timeout):
+    """Read until one of the byte strings shows up, returns it or None."""
+    seen = b""
+    deadline = time.monotonic() + timeout
+    while True:
+        for pattern in patterns:
+            if pattern in seen:
+                return pattern
+        left = deadline - time.monotonic()
+        if left <= 0 or not select.select([fd], [], [], left)[0]:
+            return None
+        seen += os.read(fd, 4096)
+
+
+def negotiate(fd, old, baud, timeout=1.0):
+    """Switch the robot and the tty from old to baud.
+
+    Returns True if the robot confirmed, otherwise the tty is put back at old.
+    """
+    os.write(fd, b"baud %d\r" % baud)
+    reply = wait_for(fd, [b"BAUD %d " % baud, b"BAUD FAIL", b"Unknown command"], timeout)
+    if reply != b"BAUD %d " % baud:
+        return False
+    if os.isatty(fd):
+        termios.tcdrain(fd)
+    time.sleep(0.01)   # Let the robot finish sending at the old rate and switch
+    set_baud(fd, baud)
+    os.write(fd, b"\rok\r")
+    if wait_for(fd, [b"BAUD OK"], timeout) == b"BAUD OK":
+        return True
+    set_baud(fd, old)
+    return False
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Switch the CyBot's UART1 baud rate")
+    parser.add_argument("device", help="serial device or pty the robot's UART1 is on")
+    parser.add_argument("baud", type=int, choices=sorted(BAUD_RATES), help="new baud rate")
+    parser.add_argument("-f", "--from", dest="old", type=int, choices=sorted(BAUD_RATES), default=115200,
+                        help="rate the robot is at now (default 115200)")
+    args = parser.parse_args()
+
+    fd = open_serial(args.device, args.old)
+    if not negotiate(fd, args.old, args.baud):
+        print("robot did not confirm %d baud, still at %d" % (args.baud, args.old), file=sys.stderr)
+        sys.exit(1)
+    print("robot and %s at %d baud" % (args.device, args.baud))
+
+
+if __name__ == "__main__":
+    main()